@@ -0,0 +1,163 @@
+#include "accumulator.h"
+
+#include <cmath>
+#include <cstring>
+
+Accumulator::Accumulator()
+{
+	clear();
+}
+
+void
+Accumulator::clear()
+{
+	mCount = 0;
+	mMean = 0;
+	mM2 = 0;
+	mMin = 0;
+	mMax = 0;
+}
+
+void
+Accumulator::add(int64_t x)
+{
+	if (x < 0) x = 0;
+
+	// Welford update of mean and squared differences.
+	mCount++;
+	double delta = x - mMean;
+	mMean += delta / mCount;
+	mM2 += delta * (x - mMean);
+
+	if (mCount == 1 || x < mMin) mMin = x;
+	if (mCount == 1 || mMax < x) mMax = x;
+}
+
+void
+Accumulator::merge(const Accumulator &acc)
+{
+	if (!acc.mCount) return;
+	if (!mCount) {
+		*this = acc;
+		return;
+	}
+
+	// Pairwise combination of means and squared differences.
+	int64_t count = mCount + acc.mCount;
+	double delta = acc.mMean - mMean;
+	mMean += delta * acc.mCount / count;
+	mM2 += acc.mM2 + delta * delta * mCount / count * acc.mCount;
+	mCount = count;
+
+	if (acc.mMin < mMin) mMin = acc.mMin;
+	if (mMax < acc.mMax) mMax = acc.mMax;
+}
+
+int64_t
+Accumulator::count() const
+{
+	return mCount;
+}
+
+double
+Accumulator::mean() const
+{
+	return mMean;
+}
+
+double
+Accumulator::variance() const
+{
+	return (1 < mCount) ? mM2 / (mCount - 1) : 0;
+}
+
+double
+Accumulator::stddev() const
+{
+	return sqrt(variance());
+}
+
+int64_t
+Accumulator::min() const
+{
+	return mMin;
+}
+
+int64_t
+Accumulator::max() const
+{
+	return mMax;
+}
+
+QuantileAccumulator::QuantileAccumulator()
+{
+	memset(mHist, 0, sizeof(mHist));
+}
+
+void
+QuantileAccumulator::clear()
+{
+	Accumulator::clear();
+	memset(mHist, 0, sizeof(mHist));
+}
+
+void
+QuantileAccumulator::add(int64_t x)
+{
+	Accumulator::add(x);
+	mHist[bin(x < 0 ? 0 : x)]++;
+}
+
+void
+QuantileAccumulator::merge(const QuantileAccumulator &acc)
+{
+	if (!acc.count()) return;
+	Accumulator::merge(acc);
+	// Values of acc lie in bins of its minimum to maximum.
+	for (int b = bin(acc.min()); b <= bin(acc.max()); b++) {
+		mHist[b] += acc.mHist[b];
+	}
+}
+
+int64_t
+QuantileAccumulator::quantile(double q) const
+{
+	if (!count() || q <= 0) return min();
+	if (1 <= q) return max();
+
+	// Bin of the value of given rank.
+	int64_t rank = ceil(q * count());
+	if (rank < 1) rank = 1;
+	int b = 0;
+	for (int64_t seen = mHist[0]; seen < rank; seen += mHist[++b]);
+
+	// Middle of bin (values of bin lie within minimum and maximum).
+	int64_t x = binValue(b);
+	if (b + 1 < ACC_BINS) x += (binValue(b + 1) - binValue(b) - 1) / 2;
+	if (x < min()) x = min();
+	if (max() < x) x = max();
+	return x;
+}
+
+int
+QuantileAccumulator::bin(uint64_t x)
+{
+	if (x < (1 << ACC_EXACT_BITS)) return x;
+	if (x >> ACC_VALUE_BITS) return ACC_BINS - 1;
+
+	// Power of two and the next ACC_SUB_BITS bits below it.
+	int e = 63 - __builtin_clzll(x);
+	int sub = (x >> (e - ACC_SUB_BITS)) & ((1 << ACC_SUB_BITS) - 1);
+	return (1 << ACC_EXACT_BITS) + ((e - ACC_EXACT_BITS) << ACC_SUB_BITS) + sub;
+}
+
+uint64_t
+QuantileAccumulator::binValue(int b)
+{
+	if (b < (1 << ACC_EXACT_BITS)) return b;
+
+	b -= 1 << ACC_EXACT_BITS;
+	int e = ACC_EXACT_BITS + (b >> ACC_SUB_BITS);
+	uint64_t sub = b & ((1 << ACC_SUB_BITS) - 1);
+	return ((1 << ACC_SUB_BITS) + sub) << (e - ACC_SUB_BITS);
+}
@@ -0,0 +1,86 @@
+#ifndef __ACCUMULATOR_H__
+#define __ACCUMULATOR_H__
+
+#include <cstdint>
+
+//! Values below are counted exactly by quantile histogram.
+#define ACC_EXACT_BITS 6
+//! Bins of quantile histogram per power of two above exact values (relative error 1/32).
+#define ACC_SUB_BITS 5
+//! Values from 2^ACC_VALUE_BITS share the last bin of quantile histogram.
+#define ACC_VALUE_BITS 32
+//! Bins of quantile histogram (exact values and sub-bins of powers of two).
+#define ACC_BINS ((1 << ACC_EXACT_BITS) + ((ACC_VALUE_BITS - ACC_EXACT_BITS) << ACC_SUB_BITS))
+
+//! Streaming statistics of non-negative values: mean and variance (Welford), minimum and
+//! maximum in a few words. Accumulators of parts (threads, runs) merge into the same
+//! result as one accumulator of all values.
+class Accumulator
+{
+public:
+	Accumulator();
+
+	//! Forget all values.
+	void clear();
+	//! Add value (negative values count as zero).
+	void add(int64_t x);
+	//! Add all values of another accumulator.
+	void merge(const Accumulator &acc);
+
+	//! Number of values.
+	int64_t count() const;
+	//! Mean of values (0 if none).
+	double mean() const;
+	//! Sample variance of values (0 for less than two).
+	double variance() const;
+	//! Standard deviation of values.
+	double stddev() const;
+	//! Minimum value (0 if none).
+	int64_t min() const;
+	//! Maximum value (0 if none).
+	int64_t max() const;
+
+private:
+	//! Number of values.
+	int64_t mCount;
+	//! Mean of values.
+	double mMean;
+	//! Sum of squared differences from mean.
+	double mM2;
+	//! Minimum value.
+	int64_t mMin;
+	//! Maximum value.
+	int64_t mMax;
+};
+
+//! Accumulator with approximate quantiles from log-linear histogram (ACC_BINS counters,
+//! about 7 KB, so it is used only where quantiles are reported).
+class QuantileAccumulator: public Accumulator
+{
+public:
+	QuantileAccumulator();
+
+	//! Forget all values.
+	void clear();
+	//! Add value (negative values count as zero).
+	void add(int64_t x);
+	//! Add all values of another accumulator.
+	void merge(const QuantileAccumulator &acc);
+
+	//! Approximate q-quantile (q in 0..1) within relative error of histogram bins,
+	//! exact for values below 2^ACC_EXACT_BITS (at most maximum for values from
+	//! 2^ACC_VALUE_BITS).
+	int64_t quantile(double q) const;
+
+protected:
+	//! Histogram bin of value.
+	static int bin(uint64_t x);
+	//! The least value of histogram bin.
+	static uint64_t binValue(int b);
+
+private:
+	//! Number of values by histogram bin.
+	int64_t mHist[ACC_BINS];
+};
+
+#endif // __ACCUMULATOR_H__
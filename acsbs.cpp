@@ -0,0 +1,270 @@
+#include "acsbs.h"
+#include "kernels.h"
+
+#include <climits>
+#include <cstring>
+
+//! Number of distances processed in one chunk (kept on stack).
+#define CHUNK_DIST 256
+
+static_assert(DECODE_PAD_WORDS <= ACSBS_PAD_WORDS, "decoders read past padding");
+
+//! Check codec and code word bits (negative word bits stand for optimal ones).
+static bool
+validCodec(int codec, int wordBits)
+{
+	if (codec == ACSBS_CODEC_ACSBS) return wordBits != 0 && wordBits < WORD_BITS_MAX;
+	if (codec == ACSBS_CODEC_RICE) return wordBits < WORD_BITS_MAX;
+	return false;
+}
+
+//! Extracts distances between ones of packed bits chunk by chunk.
+class DistReader
+{
+public:
+	DistReader(const uint64_t *bits, int nbits): mBits(bits), mCount(nbits), mWord(0),
+		mWordIndex(0), mLast(-1), mDone(false)
+	{
+		if (0 < mCount) mWord = load(0);
+	}
+
+	//! Fill dist with at most CHUNK_DIST distances, returns their number (0 at end).
+	int read(int *dist)
+	{
+		int i = 0;
+		int words = (mCount + 63) / 64;
+		while (i < CHUNK_DIST && mWordIndex < words) {
+			while (mWord && i < CHUNK_DIST) {
+				int bit = 64*mWordIndex + __builtin_ctzll(mWord);
+				dist[i++] = bit - mLast - 1;
+				mLast = bit;
+				mWord &= mWord - 1;
+			}
+			if (mWord) break;
+			if (++mWordIndex < words) mWord = load(mWordIndex);
+		}
+		// The last 'virtual' one.
+		if (i < CHUNK_DIST && words <= mWordIndex && !mDone) {
+			dist[i++] = mCount - mLast - 1;
+			mDone = true;
+		}
+		return i;
+	}
+
+private:
+	//! Word of bits with bits past the end cleared.
+	uint64_t load(int w) const
+	{
+		uint64_t word = mBits[w];
+		if (mCount < 64*(w + 1)) word &= 0xFFFFFFFFFFFFFFFF >> (64*(w + 1) - mCount);
+		return word;
+	}
+
+	const uint64_t *mBits;
+	int mCount;
+	uint64_t mWord;
+	int mWordIndex;
+	int mLast;
+	bool mDone;
+};
+
+//! Reads distances from caller array chunk by chunk.
+class DistArray
+{
+public:
+	DistArray(const int *dist, int count): mDist(dist), mCount(count), mIndex(0) {}
+
+	//! Points dist to at most CHUNK_DIST distances, returns their number (0 at end).
+	int read(const int *&dist)
+	{
+		int n = mCount - mIndex < CHUNK_DIST ? mCount - mIndex : CHUNK_DIST;
+		dist = mDist + mIndex;
+		mIndex += n;
+		return n;
+	}
+
+private:
+	const int *mDist;
+	int mCount;
+	int mIndex;
+};
+
+//! Add encoding sizes of chunk for all code word bits.
+static void
+addCost(int codec, const int *dist, int count, int64_t *total)
+{
+	int cost[WORD_BITS_MAX];
+	if (codec == ACSBS_CODEC_ACSBS) kernels().acsbsCost(dist, count, cost);
+	else kernels().riceCost(dist, count, cost);
+	for (int w = 0; w < WORD_BITS_MAX; w++) total[w] += cost[w];
+}
+
+//! Fill info from accumulated encoding sizes.
+static int
+finishInfo(int codec, int64_t ones, const int64_t *total, acsbs_info *info)
+{
+	int first = (codec == ACSBS_CODEC_ACSBS) ? 1 : 0;
+	int wordBits = first;
+	for (int w = first + 1; w < WORD_BITS_MAX; w++) {
+		if (total[w] < total[wordBits]) wordBits = w;
+	}
+	if (INT_MAX - 64*ACSBS_PAD_WORDS < total[wordBits]) return ACSBS_ERR_ARG;
+
+	info->codec = codec;
+	info->word_bits = wordBits;
+	info->ones = ones;
+	info->enc_bits = total[wordBits];
+	info->enc_words = (total[wordBits] + 63) / 64 + ACSBS_PAD_WORDS;
+	return ACSBS_OK;
+}
+
+int
+acsbs_analyze(const uint64_t *bits, uint64_t nbits, int codec, acsbs_info *info)
+{
+	if (!info || !validCodec(codec, -1) || INT_MAX <= nbits || (!bits && nbits)) return ACSBS_ERR_ARG;
+
+	int64_t total[WORD_BITS_MAX] = {0};
+	int64_t count = 0;
+	int dist[CHUNK_DIST];
+	DistReader reader(bits, nbits);
+	for (int n; (n = reader.read(dist)) > 0; count += n) addCost(codec, dist, n, total);
+
+	return finishInfo(codec, count - 1, total, info);
+}
+
+int
+acsbs_analyze_dist(const int *dist, uint64_t count, int codec, acsbs_info *info)
+{
+	if (!info || !validCodec(codec, -1) || !dist || !count || INT_MAX < count) return ACSBS_ERR_ARG;
+
+	int64_t total[WORD_BITS_MAX] = {0};
+	const int *chunk;
+	DistArray reader(dist, count);
+	for (int n; (n = reader.read(chunk)) > 0; ) {
+		for (int i = 0; i < n; i++) {
+			if (chunk[i] < 0) return ACSBS_ERR_ARG;
+		}
+		addCost(codec, chunk, n, total);
+	}
+
+	return finishInfo(codec, count - 1, total, info);
+}
+
+//! Two-pass encoding: sizes first, then code words into zeroed output.
+template <class Reader, class Chunk>
+static int
+encode(Reader &reader, Reader &again, Chunk chunk, int codec, int wordBits, uint64_t *out,
+	uint64_t outWords, uint64_t *outBits)
+{
+	int64_t total[WORD_BITS_MAX] = {0};
+	int64_t count = 0;
+	for (int n; (n = reader.read(chunk)) > 0; count += n) addCost(codec, chunk, n, total);
+
+	acsbs_info info;
+	int err = finishInfo(codec, count - 1, total, &info);
+	if (err != ACSBS_OK) return err;
+	if (0 <= wordBits) {
+		if (INT_MAX - 64*ACSBS_PAD_WORDS < total[wordBits]) return ACSBS_ERR_ARG;
+		info.word_bits = wordBits;
+		info.enc_bits = total[wordBits];
+		info.enc_words = (total[wordBits] + 63) / 64 + ACSBS_PAD_WORDS;
+	}
+	if (!out || outWords < info.enc_words) return ACSBS_ERR_SPACE;
+
+	memset(out, 0, 8*info.enc_words);
+	int end = 0;
+	for (int n; (n = again.read(chunk)) > 0; ) {
+		if (codec == ACSBS_CODEC_ACSBS) end = kernels().acsbsEncode(chunk, n, info.word_bits, out, end);
+		else end = kernels().riceEncode(chunk, n, info.word_bits, out, end);
+	}
+	if (outBits) *outBits = end;
+	return ACSBS_OK;
+}
+
+int
+acsbs_encode(const uint64_t *bits, uint64_t nbits, int codec, int word_bits,
+	uint64_t *out, uint64_t out_words, uint64_t *out_bits)
+{
+	if (!validCodec(codec, word_bits) || INT_MAX <= nbits || (!bits && nbits)) return ACSBS_ERR_ARG;
+
+	int dist[CHUNK_DIST];
+	DistReader reader(bits, nbits);
+	DistReader again(bits, nbits);
+	return encode(reader, again, dist, codec, word_bits, out, out_words, out_bits);
+}
+
+int
+acsbs_encode_dist(const int *dist, uint64_t count, int codec, int word_bits,
+	uint64_t *out, uint64_t out_words, uint64_t *out_bits)
+{
+	if (!validCodec(codec, word_bits) || !dist || !count || INT_MAX < count) return ACSBS_ERR_ARG;
+	for (uint64_t i = 0; i < count; i++) {
+		if (dist[i] < 0) return ACSBS_ERR_ARG;
+	}
+
+	const int *chunk = 0;
+	DistArray reader(dist, count);
+	DistArray again(dist, count);
+	return encode(reader, again, chunk, codec, word_bits, out, out_words, out_bits);
+}
+
+//! Decode next chunk of at most maxDist distances from bits [*begin, end).
+static int
+decodeChunk(const uint64_t *enc, int *begin, int end, int codec, int wordBits, int *dist,
+	int maxDist)
+{
+	if (codec == ACSBS_CODEC_ACSBS) return kernels().acsbsDecode(enc, begin, end, wordBits, dist, maxDist);
+	return kernels().riceDecode(enc, begin, end, wordBits, dist, maxDist);
+}
+
+//! Check arguments of decoders.
+static bool
+validDecode(const uint64_t *enc, uint64_t encBits, int codec, int wordBits)
+{
+	if (!validCodec(codec, wordBits) || wordBits < 0) return false;
+	return (enc || !encBits) && encBits <= INT_MAX - 64*ACSBS_PAD_WORDS;
+}
+
+int
+acsbs_decode(const uint64_t *enc, uint64_t enc_bits, int codec, int word_bits,
+	uint64_t *bits, uint64_t nbits)
+{
+	if (!validDecode(enc, enc_bits, codec, word_bits) || INT_MAX <= nbits || (!bits && nbits))
+		return ACSBS_ERR_ARG;
+
+	memset(bits, 0, 8*((nbits + 63) / 64));
+	int dist[CHUNK_DIST];
+	int begin = 0;
+	int64_t pos = -1;
+	int n;
+	while ((n = decodeChunk(enc, &begin, enc_bits, codec, word_bits, dist, CHUNK_DIST)) > 0) {
+		for (int i = 0; i < n; i++) {
+			// Only the last 'virtual' one may reach the end.
+			if ((int64_t)nbits <= pos) return ACSBS_ERR_DATA;
+			pos += dist[i] + 1;
+			if (pos < (int64_t)nbits) bits[pos / 64] |= (uint64_t)1 << (pos % 64);
+		}
+	}
+	if (n < 0 || pos != (int64_t)nbits || begin != (int)enc_bits) return ACSBS_ERR_DATA;
+	return ACSBS_OK;
+}
+
+int
+acsbs_decode_dist(const uint64_t *enc, uint64_t enc_bits, int codec, int word_bits,
+	int *dist, uint64_t max_dist, uint64_t *count)
+{
+	if (!validDecode(enc, enc_bits, codec, word_bits) || (!dist && max_dist) || !count)
+		return ACSBS_ERR_ARG;
+
+	int maxDist = INT_MAX < max_dist ? INT_MAX : max_dist;
+	int begin = 0;
+	int n = 0;
+	int m = 0;
+	while (n < maxDist && (m = decodeChunk(enc, &begin, enc_bits, codec, word_bits,
+		dist + n, maxDist - n)) > 0) n += m;
+	*count = n;
+	if (m < 0) return ACSBS_ERR_DATA;
+	if (begin < (int)enc_bits) return ACSBS_ERR_SPACE;
+	if (begin != (int)enc_bits) return ACSBS_ERR_DATA;
+	return ACSBS_OK;
+}
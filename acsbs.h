@@ -0,0 +1,76 @@
+#ifndef __ACSBS_H__
+#define __ACSBS_H__
+
+//! \file
+//! Stable C interface of AC-SBS and Rice-Golomb codecs. All functions work on
+//! caller buffers (packed bits, least significant bit first) and never allocate.
+//! Encoded buffers carry ACSBS_PAD_WORDS readable words past the last used word,
+//! so decoders can read whole words without bounds checks. Only the final block
+//! of code words is decoded with checks, truncated or corrupt encodings give
+//! ACSBS_ERR_DATA.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! AC-SBS codec.
+#define ACSBS_CODEC_ACSBS 1
+//! Rice-Golomb codec.
+#define ACSBS_CODEC_RICE 2
+
+//! Padding words required after encoded data.
+#define ACSBS_PAD_WORDS 1
+
+//! Success.
+#define ACSBS_OK 0
+//! Invalid argument (unknown codec, word bits or too long sequence).
+#define ACSBS_ERR_ARG -1
+//! Output buffer is too small.
+#define ACSBS_ERR_SPACE -2
+//! Malformed encoded data.
+#define ACSBS_ERR_DATA -3
+
+//! Properties of a sequence for given codec.
+typedef struct acsbs_info
+{
+	//! Codec (ACSBS_CODEC_XXX).
+	int codec;
+	//! Optimal code word bits.
+	int word_bits;
+	//! Number of ones.
+	uint64_t ones;
+	//! Bit length of encoding with optimal code word bits.
+	uint64_t enc_bits;
+	//! Number of words of output buffer needed for encoding (with padding).
+	uint64_t enc_words;
+} acsbs_info;
+
+//! Find ones, optimal code word bits and encoding size of packed bits.
+int acsbs_analyze(const uint64_t *bits, uint64_t nbits, int codec, acsbs_info *info);
+//! Find optimal code word bits and encoding size of distances between ones
+//! (count distances including the last 'virtual' one).
+int acsbs_analyze_dist(const int *dist, uint64_t count, int codec, acsbs_info *info);
+
+//! Encode packed bits (negative word_bits selects optimal ones) into out buffer of out_words
+//! words, *out_bits receives encoding length.
+int acsbs_encode(const uint64_t *bits, uint64_t nbits, int codec, int word_bits,
+	uint64_t *out, uint64_t out_words, uint64_t *out_bits);
+//! Encode distances between ones (count distances including the last 'virtual' one).
+int acsbs_encode_dist(const int *dist, uint64_t count, int codec, int word_bits,
+	uint64_t *out, uint64_t out_words, uint64_t *out_bits);
+
+//! Decode encoding of enc_bits bits into packed bits of nbits bits.
+int acsbs_decode(const uint64_t *enc, uint64_t enc_bits, int codec, int word_bits,
+	uint64_t *bits, uint64_t nbits);
+//! Decode encoding into at most max_dist distances, *count receives their number.
+int acsbs_decode_dist(const uint64_t *enc, uint64_t enc_bits, int codec, int word_bits,
+	int *dist, uint64_t max_dist, uint64_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __ACSBS_H__
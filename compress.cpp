@@ -1,268 +1,2028 @@
 #include "compress.h"
+#include "kernels.h"
 
+#include <algorithm>
 #include <cstring>
 #include <cstdlib>
 #include <iostream>
-#include <utility>
 #include <bitset>
+#include <ctime>
+#include <thread>
 
 #include <zlib.h>
 
-BitString::BitString(int bits): mString(0), mEncString(0)
+static_assert(ZLIB_FILTERED == Z_FILTERED && ZLIB_HUFFMAN_ONLY == Z_HUFFMAN_ONLY &&
+	ZLIB_RLE == Z_RLE && ZLIB_FIXED == Z_FIXED, "ZlibStrategy must match zlib.h");
+
+//! Persistent ZLIB streams and decompression buffer (one set per thread).
+class ZlibStream
+{
+public:
+	ZlibStream(): mLevel(Z_DEFAULT_COMPRESSION), mStrategy(Z_DEFAULT_STRATEGY)
+	{
+		memset(&mDeflate, 0, sizeof(mDeflate));
+		memset(&mInflate, 0, sizeof(mInflate));
+		deflateInit2(&mDeflate, mLevel, Z_DEFLATED, 15, 8, mStrategy);
+		inflateInit(&mInflate);
+	}
+
+	~ZlibStream()
+	{
+		deflateEnd(&mDeflate);
+		inflateEnd(&mInflate);
+	}
+
+	//! Compress src into dst, returns compressed size in bytes.
+	unsigned long compress(unsigned char *dst, unsigned long dstSize,
+		const unsigned char *src, unsigned long srcSize, int level, int strategy)
+	{
+		deflateReset(&mDeflate);
+		if (level != mLevel || strategy != mStrategy) {
+			deflateParams(&mDeflate, level, strategy);
+			mLevel = level;
+			mStrategy = strategy;
+		}
+		mDeflate.next_in = (Bytef *)src;
+		mDeflate.avail_in = srcSize;
+		mDeflate.next_out = dst;
+		mDeflate.avail_out = dstSize;
+		deflate(&mDeflate, Z_FINISH);
+		return mDeflate.total_out;
+	}
+
+	//! Decompress src into reusable buffer of (at least) given number of words.
+	const Word64 *uncompress(const unsigned char *src, unsigned long srcSize,
+		int words, unsigned long &size)
+	{
+		if ((int)mBuffer.size() < words) mBuffer.resize(words);
+		inflateReset(&mInflate);
+		mInflate.next_in = (Bytef *)src;
+		mInflate.avail_in = srcSize;
+		mInflate.next_out = (Bytef *)mBuffer.data();
+		mInflate.avail_out = 8*words;
+		inflate(&mInflate, Z_FINISH);
+		size = mInflate.total_out;
+		return mBuffer.data();
+	}
+
+private:
+	//! Stream used for compression.
+	z_stream mDeflate;
+	//! Stream used for decompression.
+	z_stream mInflate;
+	//! Current compression level of deflate stream.
+	int mLevel;
+	//! Current compression strategy of deflate stream.
+	int mStrategy;
+	//! Decompression buffer.
+	std::vector<Word64> mBuffer;
+};
+
+static thread_local ZlibStream zlibStream;
+
+BitString::BitString(int bits):
+	mString(0),
+	mZlibLevel(Z_DEFAULT_COMPRESSION),
+	mZlibStrategy(ZLIB_DEFAULT),
+	mEncCodec(CODEC_NONE),
+	mEncString(0),
+	mEncCache(),
+	mAutoCodec(CODEC_NONE),
+	mMemPeak(0)
 {
 	setBits(bits);
 }
 
-BitString::BitString(const BitString &bs): mString(0), mEncString(0)
+BitString::BitString(int bits, const std::vector<int> &positions):
+	mString(0),
+	mZlibLevel(Z_DEFAULT_COMPRESSION),
+	mZlibStrategy(ZLIB_DEFAULT),
+	mEncCodec(CODEC_NONE),
+	mEncString(0),
+	mEncCache(),
+	mAutoCodec(CODEC_NONE),
+	mMemPeak(0)
+{
+	setPositions(bits, positions);
+}
+
+BitString::BitString(const std::vector<int> &dist):
+	mString(0),
+	mZlibLevel(Z_DEFAULT_COMPRESSION),
+	mZlibStrategy(ZLIB_DEFAULT),
+	mEncCodec(CODEC_NONE),
+	mEncString(0),
+	mEncCache(),
+	mAutoCodec(CODEC_NONE),
+	mMemPeak(0)
+{
+	setDist(dist);
+}
+
+BitString::BitString(const BitString &bs):
+	mString(0),
+	mZlibLevel(bs.mZlibLevel),
+	mZlibStrategy(bs.mZlibStrategy),
+	mEncCodec(CODEC_NONE),
+	mEncString(0),
+	mEncCache(),
+	mAutoCodec(CODEC_NONE),
+	mMemPeak(0)
+{
+	copy(bs);
+}
+
+BitString &
+BitString::operator=(const BitString &bs)
+{
+	if (this != &bs) copy(bs);
+	return *this;
+}
+
+BitString::~BitString()
+{
+	if (mString) delete [] mString;
+	if (mEncString) delete [] mEncString;
+	for (int c = 0; c < CODEC_COUNT; c++) {
+		if (mEncCache[c].string) delete [] mEncCache[c].string;
+	}
+}
+
+void
+BitString::copy(const BitString &bs)
 {
-	setBits(bs.mBits);
+	if (bs.mString) {
+		setBits(bs.mBits);
+	} else {
+		setSparse(bs.mBits);
+	}
+	reserveEnc(64*(bs.mEncWords - 1));
+	mZlibLevel = bs.mZlibLevel;
+	mZlibStrategy = bs.mZlibStrategy;
+	mEncCodec = bs.mEncCodec;
 	mOnes = bs.mOnes;
 	mDist = bs.mDist;
+	mDistValid = bs.mDistValid;
 	mAcsbsBits = bs.mAcsbsBits;
 	mAcsbsEncBits = bs.mAcsbsEncBits;
 	mRiceBits = bs.mRiceBits;
 	mRiceEncBits = bs.mRiceEncBits;
+	mRunZeroBits = bs.mRunZeroBits;
+	mRunOneBits = bs.mRunOneBits;
+	memcpy(mAcsbsCost, bs.mAcsbsCost, sizeof(mAcsbsCost));
+	memcpy(mRiceCost, bs.mRiceCost, sizeof(mRiceCost));
 	mEncBits = bs.mEncBits;
-	memcpy((unsigned char*)mString, (const unsigned char*)bs.mString, 8*mWords);
-	memcpy((unsigned char*)mEncString, (const unsigned char*)bs.mEncString, 16*mWords);
+	if (mString) {
+		memcpy((unsigned char*)mString, (const unsigned char*)bs.mString, 8*mWords);
+	}
+	memcpy((unsigned char*)mEncString, (const unsigned char*)bs.mEncString, 8*bs.mEncWords);
 }
 
-BitString::~BitString()
+void
+BitString::setBits(int bits)
+{
+	if (mString) delete [] mString;
+	if (mEncString) delete [] mEncString;
+
+	mBits = bits;
+	mOnes = 0;
+	mWords = (bits + 63) / 64;
+	mDistValid = false;
+	mRankValid = false;
+	mEncBlockValid = false;
+	mAcsbsBits = 1;
+	mRiceBits = 0;
+	mRunZeroBits = mRunOneBits = 1;
+	mString = new Word64[mWords];
+	mEncCodec = CODEC_NONE;
+	dropCache();
+	mEncBits = 0;
+	// Room for the worst case of every encoding (incl. ZLIB stored blocks)
+	// and padding words for unaligned 64-bit reads of decoders.
+	mEncWords = 2*mWords;
+	if (8*mEncWords < (int)compressBound(8*mWords)) {
+		mEncWords = (compressBound(8*mWords) + 7) / 8;
+	}
+	mEncWords += DECODE_PAD_WORDS;
+	mEncString = new Word64[mEncWords];
+
+	memset(mString, 0, mWords*8);
+	memset(mEncString, 0, mEncWords*8);
+	noteMem();
+}
+
+void
+BitString::setPositions(int bits, const std::vector<int> &positions)
+{
+	setSparse(bits);
+	
+	// Distances between sorted positions.
+	int k = positions.size();
+	mDist.resize(k + 1);
+	int last = -1;
+	for (int i = 0; i < k; i++) {
+		mDist[i] = positions[i] - last - 1;
+		last = positions[i];
+	}
+	// The last 'virtual' one.
+	mDist[k] = bits - last - 1;
+	
+	findDist();
+}
+
+void
+BitString::setDist(const std::vector<int> &dist)
+{
+	int bits = dist.size() - 1;
+	for (int i = 0; i < (int)dist.size(); i++) {
+		bits += dist[i];
+	}
+	
+	setSparse(bits);
+	mDist = dist;
+	findDist();
+}
+
+void
+BitString::setPacked(int bits, const void *data)
+{
+	setBits(bits);
+	memcpy(mString, data, (bits + 7) / 8);
+	// Bits past the end of bitmap have to be zero.
+	if (bits % 64) mString[mWords - 1] &= 0xFFFFFFFFFFFFFFFF >> (64 - bits % 64);
+	findDist();
+}
+
+void
+BitString::setSparse(int bits)
 {
 	if (mString) delete [] mString;
 	if (mEncString) delete [] mEncString;
+	
+	mBits = bits;
+	mOnes = 0;
+	mWords = (bits + 63) / 64;
+	mDistValid = true;
+	mRankValid = false;
+	mEncBlockValid = false;
+	mAcsbsBits = 1;
+	mRiceBits = 0;
+	mRunZeroBits = mRunOneBits = 1;
+	mString = 0;
+	mEncCodec = CODEC_NONE;
+	dropCache();
+	mEncBits = 0;
+	// Encoding grows on demand (see reserveEnc()).
+	mEncWords = 1;
+	mEncString = new Word64[mEncWords];
+	mEncString[0] = 0;
+	mDist.assign(1, bits);
+	noteMem();
+}
+
+void
+BitString::densify()
+{
+	if (mString) return;
+	
+	mString = new Word64[mWords];
+	memset(mString, 0, mWords*8);
+	
+	int bit = -1;
+	for (int i = 0; i < mOnes; i++) {
+		bit += mDist[i] + 1;
+		mString[bit / 64] |= (Word64)1 << (bit % 64);
+	}
+	noteMem();
+}
+
+void
+BitString::reserveEnc(int bits)
+{
+	// Padding words for unaligned 64-bit reads of decoders.
+	int words = (bits + 63) / 64 + DECODE_PAD_WORDS;
+	if (words <= mEncWords) return;
+	
+	// Old and new buffer are held at once while copying.
+	noteMem(8*words);
+	Word64 *enc = new Word64[words];
+	memcpy(enc, mEncString, 8*mEncWords);
+	memset(enc + mEncWords, 0, 8*(words - mEncWords));
+	delete [] mEncString;
+	mEncString = enc;
+	mEncWords = words;
+}
+
+void
+BitString::clearEncPad()
+{
+	int words = (mEncBits + 63) / 64;
+	if (mEncBits % 64) mEncString[words - 1] &= ~(Word64)0 >> (64 - mEncBits % 64);
+	memset(mEncString + words, 0, 8*DECODE_PAD_WORDS);
+}
+
+void
+BitString::random(int k, bool increase)
+{
+	if (increase) {
+		if (mBits < mOnes + k) k = mBits - mOnes;
+	} else {
+		if (mBits < k) k = mBits;
+	}
+	
+	if (increase) {
+		mOnes += k;
+	} else {
+		mOnes = k;
+	}
+	
+	mDist.reserve(mOnes + 1);
+	densify();
+	
+	// Set random bits in string.
+	while (0 < k) {
+		int i = rand() % mBits;
+		if (getBit(i)) continue;
+		setBit(i);
+		k--;
+	}
+}
+
+void
+BitString::randomRuns(int k, int run, bool increase)
+{
+	if (increase) {
+		if (mBits < mOnes + k) k = mBits - mOnes;
+	} else {
+		if (mBits < k) k = mBits;
+	}
+	if (run < 1) run = 1;
+	
+	if (increase) {
+		mOnes += k;
+	} else {
+		mOnes = k;
+	}
+	
+	mDist.reserve(mOnes + 1);
+	densify();
+	
+	// Set runs of 1..2*run-1 bits at random (overlapping ones are not counted).
+	while (0 < k) {
+		int i = rand() % mBits;
+		int end = i + 1 + rand() % (2*run - 1);
+		for (; i < end && i < mBits && 0 < k; i++) {
+			if (getBit(i)) continue;
+			setBit(i);
+			k--;
+		}
+	}
+}
+
+//! Minimum number of words per thread of parallel distance extraction.
+#define DIST_CHUNK_WORDS (1 << 16)
+
+//! Number of threads of distance extraction.
+static int distThreads = 1;
+
+void
+BitString::findDist()
+{
+	int acsbsBits = mAcsbsBits;
+	int riceBits = mRiceBits;
+	
+	if (!mString) {
+		// Distances of sparse string are always up to date.
+		mOnes = mDist.size() - 1;
+		findAcsbsWordBits();
+		findRiceWordBits();
+	} else if (1 < distThreads && distThreads*DIST_CHUNK_WORDS <= mWords) {
+		findDistParallel(distThreads);
+	} else {
+		// Bits past the end of bitmap are always zero.
+		mOnes = kernels().popcount(mString, mWords);
+		mDist.resize(mOnes + 1);
+		int last = -1;
+		kernels().findDist(mString, mBits, &last, mDist.data());
+		mDist[mOnes] = mBits - last - 1;
+		
+		// Find optimal word bits for AC-SBS and Rice encodings.
+		findAcsbsWordBits();
+		findRiceWordBits();
+	}
+	selectWordBits();
+	mDistValid = true;
+	noteMem();
+	
+	// Encodings with other code word bits cannot be decoded any more.
+	if (acsbsBits != mAcsbsBits) dropEnc(CODEC_ACSBS);
+	if (riceBits != mRiceBits) dropEnc(CODEC_RICE);
+}
+
+void
+BitString::setThreads(int threads)
+{
+	distThreads = (0 < threads) ? threads : std::thread::hardware_concurrency();
+	if (distThreads < 1) distThreads = 1;
+}
+
+void
+BitString::findDistParallel(int threads)
+{
+	// Chunk of words scanned by every thread.
+	struct Chunk
+	{
+		int begin, end;
+		int ones, first, last;
+		int offset, prev;
+		int acsbsCost[WORD_BITS_MAX];
+		int riceCost[WORD_BITS_MAX];
+	};
+	std::vector<Chunk> chunks(threads);
+	for (int t = 0; t < threads; t++) {
+		chunks[t].begin = (int64_t)mWords*t / threads;
+		chunks[t].end = (int64_t)mWords*(t + 1) / threads;
+	}
+	
+	auto run = [&](void (*op)(BitString &, Chunk &)) {
+		std::vector<std::thread> pool;
+		for (int t = 1; t < threads; t++) {
+			pool.emplace_back(op, std::ref(*this), std::ref(chunks[t]));
+		}
+		op(*this, chunks[0]);
+		for (std::thread &th: pool) th.join();
+	};
+	
+	// Count ones and find the first and the last one of every chunk.
+	run([](BitString &bs, Chunk &c) {
+		c.ones = kernels().popcount(bs.mString + c.begin, c.end - c.begin);
+		c.first = c.last = -1;
+		if (!c.ones) return;
+		int w = c.begin;
+		while (!bs.mString[w]) w++;
+		c.first = 64*w + __builtin_ctzll(bs.mString[w]);
+		w = c.end - 1;
+		while (!bs.mString[w]) w--;
+		c.last = 64*w + 63 - __builtin_clzll(bs.mString[w]);
+	});
+	
+	// Offsets of distances and the last one before every chunk (stitching of gaps).
+	int ones = 0;
+	int prev = -1;
+	for (Chunk &c: chunks) {
+		c.offset = ones;
+		c.prev = prev;
+		ones += c.ones;
+		if (c.ones) prev = c.last;
+	}
+	mOnes = ones;
+	mDist.resize(mOnes + 1);
+	mDist[mOnes] = mBits - prev - 1;
+	
+	// Write distances in place and sum their encoding sizes.
+	run([](BitString &bs, Chunk &c) {
+		int *dist = bs.mDist.data() + c.offset;
+		int last = c.prev - 64*c.begin;
+		int bits = 64*(c.end - c.begin);
+		if (bs.mBits < 64*c.end) bits -= 64*c.end - bs.mBits;
+		kernels().findDist(bs.mString + c.begin, bits, &last, dist);
+		kernels().acsbsCost(dist, c.ones, c.acsbsCost);
+		kernels().riceCost(dist, c.ones, c.riceCost);
+	});
+	
+	// Merge encoding sizes (including the 'virtual' one).
+	kernels().acsbsCost(mDist.data() + mOnes, 1, mAcsbsCost);
+	kernels().riceCost(mDist.data() + mOnes, 1, mRiceCost);
+	for (Chunk &c: chunks) {
+		for (int w = 0; w < WORD_BITS_MAX; w++) {
+			mAcsbsCost[w] += c.acsbsCost[w];
+			mRiceCost[w] += c.riceCost[w];
+		}
+	}
+}
+
+void
+BitString::setZlibParams(int level, ZlibStrategy strategy)
+{
+	if (level != mZlibLevel || strategy != mZlibStrategy) dropEnc(CODEC_ZLIB);
+	mZlibLevel = level;
+	mZlibStrategy = strategy;
+}
+
+void
+BitString::setZlibDistEnc()
+{
+	if (useEnc(CODEC_ZLIB)) return;
+	densify();
+	reserveEnc(8*compressBound((mBits + 7) / 8));
+	unsigned long size = zlibStream.compress((unsigned char *)mEncString, 8*mEncWords,
+		(const unsigned char *)mString, (mBits + 7) / 8, mZlibLevel, mZlibStrategy);
+	mEncBits = 8*size;
+	clearEncPad();
+	mEncCodec = CODEC_ZLIB;
+}
+
+//! Number of bits of AC-SBS code words of single distance.
+static inline int
+acsbsCodeBits(int d, int acsbsBits)
+{
+	return acsbsBits*(d / ((1 << acsbsBits) - 1) + 1);
+}
+
+//! Number of bits of Rice-Golomb code word of single distance.
+static inline int
+riceCodeBits(int d, int riceBits)
+{
+	return (d >> riceBits) + 1 + riceBits;
+}
+
+//! Set bits [bit, bit + count) to zero.
+static void
+clearBits(Word64 *enc, int bit, int count)
+{
+	while (0 < count) {
+		int n = 64 - bit % 64 < count ? 64 - bit % 64 : count;
+		enc[bit / 64] &= ~((0xFFFFFFFFFFFFFFFF >> (64 - n)) << (bit % 64));
+		bit += n;
+		count -= n;
+	}
+}
+
+//! Get n (up to 64) bits starting at given bit.
+static inline Word64
+getBits(const Word64 *enc, int bit, int n)
+{
+	Word64 word = enc[bit / 64] >> (bit % 64);
+	if (64 - bit % 64 < n) word |= enc[bit / 64 + 1] << (64 - bit % 64);
+	return n < 64 ? word & ((Word64(1) << n) - 1) : word;
+}
+
+//! Replace n (up to 64) bits starting at given bit.
+static inline void
+putBits(Word64 *enc, int bit, int n, Word64 word)
+{
+	clearBits(enc, bit, n);
+	enc[bit / 64] |= word << (bit % 64);
+	if (64 - bit % 64 < n) enc[bit / 64 + 1] |= word >> (64 - bit % 64);
+}
+
+//! Copy count bits between different buffers.
+static void
+copyBits(Word64 *dst, int dstBit, const Word64 *src, int srcBit, int count)
+{
+	for (int i = 0; i < count; i += 64) {
+		int n = count - i < 64 ? count - i : 64;
+		putBits(dst, dstBit + i, n, getBits(src, srcBit + i, n));
+	}
+}
+
+//! Move count bits from one position to another (ranges may overlap).
+static void
+moveBits(Word64 *enc, int from, int to, int count)
+{
+	if (from == to) return;
+	if (to < from) {
+		for (int i = 0; i < count; i += 64) {
+			int n = count - i < 64 ? count - i : 64;
+			putBits(enc, to + i, n, getBits(enc, from + i, n));
+		}
+	} else {
+		for (int i = count; 0 < i; i -= 64) {
+			int n = i < 64 ? i : 64;
+			putBits(enc, to + i - n, n, getBits(enc, from + i - n, n));
+		}
+	}
+}
+
+//! Write AC-SBS encoding of distances starting at given bit, returns end bit.
+static inline int
+acsbsEncode(const int *dist, int count, int acsbsBits, Word64 *enc, int encBits)
+{
+	return kernels().acsbsEncode(dist, count, acsbsBits, enc, encBits);
+}
+
+//! Write Rice-Golomb encoding of distances starting at given bit, returns end bit.
+static inline int
+riceEncode(const int *dist, int count, int riceBits, Word64 *enc, int encBits)
+{
+	return kernels().riceEncode(dist, count, riceBits, enc, encBits);
+}
+
+//! Decode AC-SBS encoding from bits [begin, end), false if it is malformed.
+static bool
+acsbsDecode(const Word64 *encString, int begin, int end, int acsbsBits, int ones,
+	std::vector<int> &dist)
+{
+	// Every code word can end a distance (ones is only a hint).
+	int count = (end - begin + acsbsBits - 1) / acsbsBits;
+	dist.resize(ones + 1 < count ? count : ones + 1);
+	int n = kernels().acsbsDecode(encString, &begin, end, acsbsBits, dist.data(), dist.size());
+	dist.resize(n < 0 ? 0 : n);
+	return 0 <= n;
+}
+
+//! Decode Rice-Golomb encoding from bits [begin, end), false if it is malformed.
+static bool
+riceDecode(const Word64 *encString, int begin, int end, int riceBits, int ones,
+	std::vector<int> &dist)
+{
+	// Every code word has at least riceBits + 1 bits (ones is only a hint).
+	int count = (end - begin + riceBits) / (riceBits + 1);
+	dist.resize(ones + 1 < count ? count : ones + 1);
+	int n = kernels().riceDecode(encString, &begin, end, riceBits, dist.data(), dist.size());
+	dist.resize(n < 0 ? 0 : n);
+	return 0 <= n;
+}
+
+//! Extract distances between ones of packed bits.
+static void
+bitsToDist(const Word64 *words, int bits, std::vector<int> &dist)
+{
+	int ones = kernels().popcount(words, bits / 64);
+	if (bits % 64) {
+		ones += __builtin_popcountll(words[bits / 64] << (64 - bits % 64));
+	}
+	dist.resize(ones + 1);
+	int last = -1;
+	kernels().findDist(words, bits, &last, dist.data());
+	dist[ones] = bits - last - 1;
+}
+
+//! Check if distances (including the 'virtual' one) fill string of given bits.
+static bool
+isDistOf(const std::vector<int> &dist, int bits)
+{
+	int64_t total = (int64_t)dist.size() - 1;
+	for (int i = 0; i < (int)dist.size(); i++) total += dist[i];
+	return total == bits;
+}
+
+//! Check if distances of batch decoders fill their strings.
+static bool
+isDistOf(const BitString *const *bs, int count, const int *const *dist)
+{
+	for (int i = 0; i < count; i++) {
+		int64_t total = bs[i]->getOnes();
+		for (int j = 0; j < bs[i]->getOnes() + 1; j++) total += dist[i][j];
+		if (total != bs[i]->getBits()) return false;
+	}
+	return true;
+}
+
+//! Distances between zeros from distances between ones (and vice versa).
+static void
+complementDist(const std::vector<int> &dist, std::vector<int> &compl_)
+{
+	int bits = dist.size() - 1;
+	for (int i = 0; i < (int)dist.size(); i++) bits += dist[i];
+
+	compl_.resize(bits - (dist.size() - 1) + 1);
+
+	int j = 0;
+	int c = 0;
+	for (int i = 0; i < (int)dist.size(); i++) {
+		// Run of zeros: the first one gets all pending ones, the rest none.
+		if (0 < dist[i]) {
+			compl_[j++] = c;
+			for (int z = 1; z < dist[i]; z++) compl_[j++] = 0;
+			c = 0;
+		}
+		// The one after zeros (except the 'virtual' one).
+		if (i < (int)dist.size() - 1) c++;
+	}
+	// The last 'virtual' zero.
+	compl_[j] = c;
+}
+
+//! Distances between zeros which follow ones (returns number of remaining zero distances).
+static int
+complementRuns(const std::vector<int> &dist, std::vector<int> &runs)
+{
+	int zeros = 0;
+	int c = 0;
+	runs.clear();
+	for (int i = 0; i < (int)dist.size(); i++) {
+		if (0 < dist[i]) {
+			if (0 < c) {
+				runs.push_back(c);
+				zeros += dist[i] - 1;
+			} else {
+				zeros += dist[i];
+			}
+			c = 0;
+		}
+		if (i < (int)dist.size() - 1) c++;
+	}
+	// The last 'virtual' zero.
+	if (0 < c) {
+		runs.push_back(c);
+	} else {
+		zeros += 1;
+	}
+	return zeros;
+}
+
+//! Optimal AC-SBS word bits for given distances and number of extra zero distances
+//! (bits receives the encoding size).
+static int
+acsbsWordBits(const int *dist, int count, int zeros, int &bits)
+{
+	int cost[WORD_BITS_MAX];
+	kernels().acsbsCost(dist, count, cost);
+	
+	int wordBits = 1;
+	bits = cost[1] + zeros;
+	for (int w = 2; w < WORD_BITS_MAX; w++) {
+		if (cost[w] + w*zeros < bits) {
+			wordBits = w;
+			bits = cost[w] + w*zeros;
+		}
+	}
+	return wordBits;
+}
+
+//! Optimal Rice-Golomb word bits for given distances and number of extra zero distances
+//! (bits receives the encoding size).
+static int
+riceWordBits(const int *dist, int count, int zeros, int &bits)
+{
+	int cost[WORD_BITS_MAX];
+	kernels().riceCost(dist, count, cost);
+	
+	int wordBits = 0;
+	bits = cost[0] + zeros;
+	for (int w = 1; w < WORD_BITS_MAX; w++) {
+		if (cost[w] + (1 + w)*zeros < bits) {
+			wordBits = w;
+			bits = cost[w] + (1 + w)*zeros;
+		}
+	}
+	return wordBits;
+}
+
+//! Linear model of decoding time used by automatic codec selection.
+struct AutoCostModel
+{
+	//! Time [ns] per decoding unit (code word, unary bit or packed word).
+	double perUnit[CODEC_COUNT];
+	//! Time [ns] per decoded distance.
+	double perDist[CODEC_COUNT];
+	//! Size of one nanosecond of decoding time in bits.
+	double bitsPerNs;
+};
+
+//! Default model (roughly calibrated on x86-64 at -O2).
+static AutoCostModel autoCost = {
+	// NONE, ACSBS, RICE, ZLIB, RAW, ACSBS_COMPL, RICE_COMPL, AUTO, ACSBS_RUNS
+	{ 0, 1.0, 0.8, 0, 0.6, 1.0, 0.8, 0, 0 },
+	{ 0, 1.5, 2.5, 0, 1.5, 1.5, 2.5, 0, 0 },
+	0.05
+};
+
+//! Number of streams decoded together by batch decoders.
+static const int BATCH_LANES = 8;
+
+//! Number of bits used by tag of automatically selected encoding.
+static const int AUTO_TAG_BITS = 8;
+
+//! Decoding cost of given codec in nanoseconds.
+static double
+autoDecodeCost(Codec codec, double units, double dists)
+{
+	return autoCost.perUnit[codec]*units + autoCost.perDist[codec]*dists;
+}
+
+void
+BitString::setAcsbsDistEnc()
+{
+	if (useEnc(CODEC_ACSBS)) return;
+	reserveEnc(mAcsbsEncBits);
+	memset(mEncString, 0, 8*((mAcsbsEncBits + 63) / 64));
+	mEncBits = acsbsEncode(mDist.data(), mOnes + 1, mAcsbsBits, mEncString, 0);
+	clearEncPad();
+	mEncCodec = CODEC_ACSBS;
+}
+
+void
+BitString::setRiceDistEnc()
+{
+	if (useEnc(CODEC_RICE)) return;
+	reserveEnc(mRiceEncBits);
+	memset(mEncString, 0, 8*((mRiceEncBits + 63) / 64));
+	mEncBits = riceEncode(mDist.data(), mOnes + 1, mRiceBits, mEncString, 0);
+	clearEncPad();
+	mEncCodec = CODEC_RICE;
+}
+
+//! Runs of zeros before every run of ones (and after the last one) and lengths of runs
+//! of ones minus one from distances.
+static void
+distToRuns(const std::vector<int> &dist, std::vector<int> &zeros, std::vector<int> &ones)
+{
+	int k = dist.size() - 1;
+	zeros.clear();
+	ones.clear();
+	for (int i = 0; i < k; ) {
+		zeros.push_back(dist[i]);
+		int j = i + 1;
+		while (j < k && dist[j] == 0) j++;
+		ones.push_back(j - i - 1);
+		i = j;
+	}
+	zeros.push_back(dist[k]);
+}
+
+//! Write AC-SBS code words of single value, returns end bit.
+static inline int
+acsbsPut(Word64 *enc, int bit, int d, int w)
+{
+	Word64 m = ((Word64)1 << w) - 1;
+	for (; m <= (Word64)d; d -= m, bit += w) putBits(enc, bit, w, m);
+	putBits(enc, bit, w, d);
+	return bit + w;
+}
+
+//! Read AC-SBS code words of single value (bit is moved past them).
+static inline int
+acsbsGet(const Word64 *enc, int &bit, int end, int w)
+{
+	Word64 m = ((Word64)1 << w) - 1;
+	int d = 0;
+	Word64 c;
+	do {
+		c = getBits(enc, bit, w);
+		d += c;
+		bit += w;
+	} while (c == m && bit < end);
+	return d;
+}
+
+void
+BitString::setRunDistEnc()
+{
+	static thread_local std::vector<int> zeros;
+	static thread_local std::vector<int> ones;
+	int bits;
+	
+	if (useEnc(CODEC_ACSBS_RUNS)) return;
+	distToRuns(mDist, zeros, ones);
+	mRunZeroBits = acsbsWordBits(zeros.data(), zeros.size(), 0, bits);
+	int encBits = bits;
+	mRunOneBits = acsbsWordBits(ones.data(), ones.size(), 0, bits);
+	encBits += bits;
+	
+	reserveEnc(encBits);
+	memset(mEncString, 0, 8*((encBits + 63) / 64));
+	int bit = 0;
+	for (int r = 0; r < (int)ones.size(); r++) {
+		bit = acsbsPut(mEncString, bit, zeros[r], mRunZeroBits);
+		bit = acsbsPut(mEncString, bit, ones[r], mRunOneBits);
+	}
+	mEncBits = acsbsPut(mEncString, bit, zeros.back(), mRunZeroBits);
+	clearEncPad();
+	mEncCodec = CODEC_ACSBS_RUNS;
+}
+
+void
+BitString::setAutoDistEnc()
+{
+	if (!mDistValid) findDist();
+	// Selection is kept until the string changes.
+	if (mAutoCodec != CODEC_NONE) {
+		setTaggedDistEnc(mAutoCodec);
+		return;
+	}
+	
+	Codec codec = CODEC_ACSBS;
+	double units = (double)mAcsbsEncBits / mAcsbsBits;
+	double best = mAcsbsEncBits + autoCost.bitsPerNs*autoDecodeCost(codec, units, mOnes + 1);
+	
+	// Rice-Golomb (units are bits of unary parts).
+	units = mRiceEncBits - (double)(mOnes + 1)*mRiceBits;
+	double score = mRiceEncBits + autoCost.bitsPerNs*autoDecodeCost(CODEC_RICE, units, mOnes + 1);
+	if (score < best) {
+		codec = CODEC_RICE;
+		best = score;
+	}
+	
+	// Raw bitmap (units are packed words).
+	score = mBits + autoCost.bitsPerNs*autoDecodeCost(CODEC_RAW, mWords, mOnes + 1);
+	if (score < best) {
+		codec = CODEC_RAW;
+		best = score;
+	}
+	
+	// Complement needs at least one bit per zero, so it is examined only if it can win.
+	int zeros = mBits - mOnes;
+	if (zeros + 1 < best) {
+		static thread_local std::vector<int> runs;
+		int zeroDist = complementRuns(mDist, runs);
+		
+		int bits;
+		int w = acsbsWordBits(runs.data(), runs.size(), zeroDist, bits);
+		units = (double)bits / w;
+		score = bits + autoCost.bitsPerNs*autoDecodeCost(CODEC_ACSBS_COMPL, units, zeros + mOnes + 2);
+		if (score < best) {
+			codec = CODEC_ACSBS_COMPL;
+			best = score;
+		}
+		
+		w = riceWordBits(runs.data(), runs.size(), zeroDist, bits);
+		units = bits - (double)(zeros + 1)*w;
+		score = bits + autoCost.bitsPerNs*autoDecodeCost(CODEC_RICE_COMPL, units, zeros + mOnes + 2);
+		if (score < best) {
+			codec = CODEC_RICE_COMPL;
+			best = score;
+		}
+	}
+	
+	mAutoCodec = codec;
+	setTaggedDistEnc(codec);
+}
+
+void
+BitString::setTaggedDistEnc(Codec codec)
+{
+	static thread_local std::vector<int> compl_;
+	int w = 0;
+	int bits = 0;
+
+	if (useEnc(CODEC_AUTO) && getEncCodec() == codec) return;
+	switch (codec) {
+	case CODEC_ACSBS:
+		w = mAcsbsBits;
+		reserveEnc(AUTO_TAG_BITS + mAcsbsEncBits);
+		memset(mEncString, 0, 8*((AUTO_TAG_BITS + mAcsbsEncBits + 63) / 64));
+		mEncBits = acsbsEncode(mDist.data(), mOnes + 1, w, mEncString, AUTO_TAG_BITS);
+		break;
+	case CODEC_RICE:
+		w = mRiceBits;
+		reserveEnc(AUTO_TAG_BITS + mRiceEncBits);
+		memset(mEncString, 0, 8*((AUTO_TAG_BITS + mRiceEncBits + 63) / 64));
+		mEncBits = riceEncode(mDist.data(), mOnes + 1, w, mEncString, AUTO_TAG_BITS);
+		break;
+	case CODEC_RAW:
+		densify();
+		reserveEnc(AUTO_TAG_BITS + mBits);
+		memset(mEncString, 0, 8*((AUTO_TAG_BITS + mBits + 63) / 64));
+		memcpy((unsigned char *)mEncString + AUTO_TAG_BITS / 8, mString, (mBits + 7) / 8);
+		mEncBits = AUTO_TAG_BITS + mBits;
+		break;
+	case CODEC_ACSBS_COMPL:
+		complementDist(mDist, compl_);
+		w = acsbsWordBits(compl_.data(), compl_.size(), 0, bits);
+		reserveEnc(AUTO_TAG_BITS + bits);
+		memset(mEncString, 0, 8*((AUTO_TAG_BITS + bits + 63) / 64));
+		mEncBits = acsbsEncode(compl_.data(), compl_.size(), w, mEncString, AUTO_TAG_BITS);
+		break;
+	case CODEC_RICE_COMPL:
+		complementDist(mDist, compl_);
+		w = riceWordBits(compl_.data(), compl_.size(), 0, bits);
+		reserveEnc(AUTO_TAG_BITS + bits);
+		memset(mEncString, 0, 8*((AUTO_TAG_BITS + bits + 63) / 64));
+		mEncBits = riceEncode(compl_.data(), compl_.size(), w, mEncString, AUTO_TAG_BITS);
+		break;
+	default:
+		// Only distance encodings (and raw bitmap) can be tagged.
+		setTaggedDistEnc(CODEC_RAW);
+		return;
+	}
+	
+	// Tag: codec in low 3 bits, code word bits in high 5 bits.
+	mEncString[0] |= (Word64)(codec | (w << 3));
+	clearEncPad();
+	mEncCodec = CODEC_AUTO;
+}
+
+void
+BitString::getZlibDistEnc(std::vector<int> &dist) const
+{
+	unsigned long size;
+	int encBits;
+	const Word64 *enc = getEnc(CODEC_ZLIB, encBits);
+	const Word64 *buf = zlibStream.uncompress((const unsigned char *)enc,
+		encBits / 8, mWords, size);
+	int bits = 8*(int)size < mBits ? 8*(int)size : mBits;
+	
+	bitsToDist(buf, bits, dist);
+}
+
+bool
+BitString::getAcsbsDistEnc(std::vector<int> &dist) const
+{
+	int encBits;
+	const Word64 *enc = getEnc(CODEC_ACSBS, encBits);
+	// Distances have to fill string (as in BitmapStore::getDist()).
+	if (acsbsDecode(enc, 0, encBits, mAcsbsBits, mOnes, dist) &&
+		(int)dist.size() == mOnes + 1 && isDistOf(dist, mBits)) return true;
+	dist.clear();
+	return false;
+}
+
+bool
+BitString::getRiceDistEnc(std::vector<int> &dist) const
+{
+	int encBits;
+	const Word64 *enc = getEnc(CODEC_RICE, encBits);
+	if (riceDecode(enc, 0, encBits, mRiceBits, mOnes, dist) &&
+		(int)dist.size() == mOnes + 1 && isDistOf(dist, mBits)) return true;
+	dist.clear();
+	return false;
+}
+
+bool
+BitString::getRunDistEnc(std::vector<int> &dist) const
+{
+	int encBits;
+	const Word64 *enc = getEnc(CODEC_ACSBS_RUNS, encBits);
+	dist.resize(mOnes + 1);
+	int bit = 0;
+	int i = 0;
+	for (;;) {
+		int z = acsbsGet(enc, bit, encBits, mRunZeroBits);
+		// The last run of zeros has no ones after it.
+		if (encBits <= bit || mOnes <= i) {
+			dist[i++] = z;
+			break;
+		}
+		int o = acsbsGet(enc, bit, encBits, mRunOneBits);
+		// Run of ones past the last one.
+		if (o < 0 || mOnes < i + o + 1) break;
+		dist[i++] = z;
+		memset(dist.data() + i, 0, 4*o);
+		i += o;
+	}
+	
+	// All code words give all distances filling string.
+	if (bit == encBits && i == mOnes + 1 && isDistOf(dist, mBits)) return true;
+	dist.clear();
+	return false;
+}
+
+bool
+BitString::getRunBitsEnc(std::vector<Word64> &words) const
+{
+	int encBits;
+	const Word64 *enc = getEnc(CODEC_ACSBS_RUNS, encBits);
+	words.assign(mWords, 0);
+	int bit = 0;
+	int pos = 0;
+	for (;;) {
+		pos += acsbsGet(enc, bit, encBits, mRunZeroBits);
+		if (encBits <= bit) break;
+		int end = pos + 1 + acsbsGet(enc, bit, encBits, mRunOneBits);
+		// Run of ones past the end of string.
+		if (end <= pos || mBits < end) return false;
+		
+		// Partial words at both ends, whole words in between.
+		int first = pos / 64;
+		int last = (end - 1) / 64;
+		Word64 head = 0xFFFFFFFFFFFFFFFF << (pos % 64);
+		Word64 tail = 0xFFFFFFFFFFFFFFFF >> (63 - (end - 1) % 64);
+		if (first == last) {
+			words[first] |= head & tail;
+		} else {
+			words[first] |= head;
+			memset(words.data() + first + 1, 0xFF, 8*(last - first - 1));
+			words[last] |= tail;
+		}
+		pos = end;
+	}
+	return bit == encBits && pos == mBits;
+}
+
+bool
+BitString::getAutoDistEnc(std::vector<int> &dist) const
+{
+	int encBits;
+	const Word64 *enc = getEnc(CODEC_AUTO, encBits);
+	return getTaggedDist(enc, encBits, mBits, mOnes, dist);
+}
+
+bool
+BitString::getTaggedDist(const Word64 *enc, int encBits, int bits, int ones,
+	std::vector<int> &dist)
+{
+	static thread_local std::vector<int> compl_;
+	static thread_local std::vector<Word64> raw;
+	Codec codec = (Codec)(encBits ? enc[0] & 0x7 : CODEC_NONE);
+	int w = (enc[0] & 0xFF) >> 3;
+
+	// Code word bits out of range of codec.
+	if ((codec == CODEC_ACSBS || codec == CODEC_ACSBS_COMPL) && w == 0) codec = CODEC_NONE;
+
+	switch (codec) {
+	case CODEC_ACSBS:
+		if (!acsbsDecode(enc, AUTO_TAG_BITS, encBits, w, ones, dist) ||
+			(int)dist.size() != ones + 1 || !isDistOf(dist, bits)) break;
+		return true;
+	case CODEC_RICE:
+		if (!riceDecode(enc, AUTO_TAG_BITS, encBits, w, ones, dist) ||
+			(int)dist.size() != ones + 1 || !isDistOf(dist, bits)) break;
+		return true;
+	case CODEC_RAW:
+		if (encBits < AUTO_TAG_BITS + bits) break;
+		if ((int)raw.size() < (bits + 63) / 64) raw.resize((bits + 63) / 64);
+		memcpy(raw.data(), (const unsigned char *)enc + AUTO_TAG_BITS / 8, (bits + 7) / 8);
+		bitsToDist(raw.data(), bits, dist);
+		return true;
+	case CODEC_ACSBS_COMPL:
+		if (!acsbsDecode(enc, AUTO_TAG_BITS, encBits, w, bits - ones, compl_) ||
+			!isDistOf(compl_, bits)) break;
+		complementDist(compl_, dist);
+		return true;
+	case CODEC_RICE_COMPL:
+		if (!riceDecode(enc, AUTO_TAG_BITS, encBits, w, bits - ones, compl_) ||
+			!isDistOf(compl_, bits)) break;
+		complementDist(compl_, dist);
+		return true;
+	default:
+		break;
+	}
+	dist.clear();
+	return false;
+}
+
+bool
+BitString::getAcsbsDistEncBatch(const BitString *const *bs, int count, int *const *dist)
+{
+	// Lane state.
+	const Word32 *enc[BATCH_LANES];
+	int bit[BATCH_LANES];
+	int end[BATCH_LANES];
+	int w[BATCH_LANES];
+	int m[BATCH_LANES];
+	int *out[BATCH_LANES];
+	int *outEnd[BATCH_LANES];
+	Word64 acc[BATCH_LANES];
+	Word64 over = 0;
+	bool ok = true;
+	
+	int next = 0;
+	int lanes = 0;
+	while (next < count || 0 < lanes) {
+		// Fill free lanes with next streams.
+		while (lanes < BATCH_LANES && next < count) {
+			const BitString &s = *bs[next];
+			enc[lanes] = (const Word32*)s.getEnc(CODEC_ACSBS, end[lanes]);
+			bit[lanes] = 0;
+			w[lanes] = s.mAcsbsBits;
+			m[lanes] = 0xFFFFFFFF >> (32 - s.mAcsbsBits);
+			out[lanes] = dist[next];
+			outEnd[lanes] = dist[next] + s.getOnes() + 1;
+			acc[lanes] = 0;
+			// Empty encoding has nothing to decode.
+			if (0 < end[lanes]) lanes++;
+			next++;
+		}
+		
+		// Rounds until the first lane ends (whole code words and room for distances).
+		int rounds = 0x7FFFFFFF;
+		for (int j = 0; j < lanes; j++) {
+			int r = (end[j] - bit[j]) / w[j];
+			if (outEnd[j] - out[j] < r) r = outEnd[j] - out[j];
+			if (r < rounds) rounds = r;
+		}
+		
+		// One code word of every lane per round (independent dependency chains).
+		for (int r = 0; r < rounds; r++) {
+			for (int j = 0; j < lanes; j++) {
+				int d = (*(const Word64*)(enc[j] + (bit[j] / 32)) >> (bit[j] % 32)) & m[j];
+				*out[j] = acc[j] + d;
+				over |= acc[j] + d;
+				acc[j] = (d == m[j]) ? acc[j] + d : 0;
+				out[j] += (d != m[j]);
+				bit[j] += w[j];
+			}
+		}
+		
+		// Retire finished lanes (malformed ones end with bits or escape left).
+		for (int j = 0; j < lanes; j++) {
+			if (w[j] <= end[j] - bit[j] && out[j] < outEnd[j]) continue;
+			ok &= bit[j] == end[j] && !acc[j] && out[j] == outEnd[j];
+			lanes--;
+			enc[j] = enc[lanes];
+			bit[j] = bit[lanes];
+			end[j] = end[lanes];
+			w[j] = w[lanes];
+			m[j] = m[lanes];
+			out[j] = out[lanes];
+			outEnd[j] = outEnd[lanes];
+			acc[j] = acc[lanes];
+			j--;
+		}
+	}
+	
+	return ok && !(over >> 31) && isDistOf(bs, count, dist);
+}
+
+bool
+BitString::getRiceDistEncBatch(const BitString *const *bs, int count, int *const *dist)
+{
+	// Lane state.
+	const Word32 *enc[BATCH_LANES];
+	int bit[BATCH_LANES];
+	int safe[BATCH_LANES];
+	int end[BATCH_LANES];
+	int w[BATCH_LANES];
+	int *out[BATCH_LANES];
+	int *outEnd[BATCH_LANES];
+	Word64 over = 0;
+	bool ok = true;
+	
+	int next = 0;
+	int lanes = 0;
+	while (next < count || 0 < lanes) {
+		// Fill free lanes with next streams.
+		while (lanes < BATCH_LANES && next < count) {
+			const BitString &s = *bs[next];
+			enc[lanes] = (const Word32*)s.getEnc(CODEC_RICE, end[lanes]);
+			bit[lanes] = 0;
+			// Code words from the final block on are left to checked kernel.
+			safe[lanes] = end[lanes] - 32;
+			w[lanes] = s.mRiceBits;
+			out[lanes] = dist[next];
+			outEnd[lanes] = dist[next] + s.getOnes() + 1;
+			// Empty encoding has nothing to decode.
+			if (0 < end[lanes]) lanes++;
+			next++;
+		}
+		
+		// One code word of every lane per round (independent dependency chains).
+		for (int j = 0; j < lanes; j++) {
+			if (safe[j] <= bit[j]) continue;
+			int b = bit[j];
+			Word64 word = (*(const Word64*)(enc[j] + (b / 32)) >> (b % 32));
+			int q = 0;
+			int ones;
+			// At least 33 loaded bits are valid, so long unary parts go by 32 bits.
+			while (32 <= (ones = __builtin_ctzll(~word | 0x8000000000000000))) {
+				q += 32;
+				b += 32;
+				if (safe[j] <= b) break;
+				word = (*(const Word64*)(enc[j] + (b / 32)) >> (b % 32));
+			}
+			if (safe[j] <= b) {
+				// Long unary part reaching the final block.
+				safe[j] = bit[j];
+				continue;
+			}
+			q += ones;
+			b += ones + 1;
+			word = (*(const Word64*)(enc[j] + (b / 32)) >> (b % 32));
+			Word64 d = ((Word64)q << w[j]) + (word & ((Word64(1) << w[j]) - 1));
+			over |= d;
+			*out[j]++ = d;
+			bit[j] = b + w[j];
+		}
+		
+		// Retire lanes with full output or in the final block (decoded with checks).
+		for (int j = 0; j < lanes; j++) {
+			if (bit[j] < safe[j] && out[j] < outEnd[j]) continue;
+			int n = kernels().riceDecode((const Word64 *)enc[j], &bit[j], end[j], w[j], out[j],
+				outEnd[j] - out[j]);
+			ok &= 0 <= n && bit[j] == end[j] && out[j] + n == outEnd[j];
+			lanes--;
+			enc[j] = enc[lanes];
+			bit[j] = bit[lanes];
+			safe[j] = safe[lanes];
+			end[j] = end[lanes];
+			w[j] = w[lanes];
+			out[j] = out[lanes];
+			outEnd[j] = outEnd[lanes];
+			j--;
+		}
+	}
+	
+	return ok && !(over >> 31) && isDistOf(bs, count, dist);
+}
+
+int
+BitString::getBits() const
+{
+	return mBits;
+}
+
+int
+BitString::getOnes() const
+{
+	// Changed bitmap is counted again (unless directory is up to date).
+	if (mDistValid) return mOnes;
+	if (mRankValid) return (Word32)mRank.back();
+	return kernels().popcount(mString, mWords);
+}
+
+bool
+BitString::isDistValid() const
+{
+	return mDistValid;
+}
+
+int
+BitString::getEncBits() const
+{
+	return mEncBits;
+}
+
+MemUsage
+BitString::getMemUsage() const
+{
+	MemUsage mem;
+	mem.live = sizeof(*this);
+	mem.unused = 0;
+	
+	// Bitmap (none for sparse string).
+	if (mString) mem.live += 8*mWords;
+	
+	// Current encoding (padding words of decoders are in use).
+	int used = (mEncBits + 63) / 64 + DECODE_PAD_WORDS;
+	mem.live += 8*mEncWords;
+	if (used < mEncWords) mem.unused += 8*(mEncWords - used);
+	
+	// Kept encodings (buffers of invalid ones are unused).
+	for (int c = 0; c < CODEC_COUNT; c++) {
+		const EncCache &cache = mEncCache[c];
+		if (!cache.string) continue;
+		used = cache.valid ? (cache.bits + 63) / 64 + DECODE_PAD_WORDS : 0;
+		mem.live += 8*cache.words;
+		if (used < cache.words) mem.unused += 8*(cache.words - used);
+	}
+	
+	// Distances as reserved and used.
+	mem.live += sizeof(int)*mDist.capacity();
+	mem.unused += sizeof(int)*(mDist.capacity() - mDist.size());
+	
+	// Rank/select directory (out of date one is unused).
+	int64_t rank = sizeof(Word64)*mRank.capacity() + sizeof(int)*mSelect.capacity();
+	mem.live += rank;
+	if (mRankValid) {
+		mem.unused += sizeof(Word64)*(mRank.capacity() - mRank.size());
+		mem.unused += sizeof(int)*(mSelect.capacity() - mSelect.size());
+	} else {
+		mem.unused += rank;
+	}
+	
+	// Offsets of code word blocks (out of date ones are unused).
+	mem.live += sizeof(int)*mEncBlock.capacity();
+	mem.unused += sizeof(int)*(mEncBlockValid ? mEncBlock.capacity() - mEncBlock.size() :
+		mEncBlock.capacity());
+	
+	mem.peak = std::max(mMemPeak, mem.live);
+	return mem;
+}
+
+void
+BitString::resetMemPeak()
+{
+	mMemPeak = 0;
+	noteMem();
+}
+
+void
+BitString::noteMem(int64_t extra)
+{
+	mMemPeak = std::max(mMemPeak, getMemUsage().live + extra);
+}
+
+Codec
+BitString::getEncCodec() const
+{
+	if (mEncCodec == CODEC_AUTO) {
+		return (Codec)(mEncString[0] & 0x7);
+	}
+	return mEncCodec;
+}
+
+void
+BitString::setAutoCostWeight(double bitsPerNs)
+{
+	autoCost.bitsPerNs = bitsPerNs;
+}
+
+void
+BitString::calibrateAutoCost(int bits)
+{
+	static const Codec codecs[] = {
+		CODEC_ACSBS, CODEC_RICE, CODEC_RAW, CODEC_ACSBS_COMPL, CODEC_RICE_COMPL
+	};
+	static const double density[] = { 0.01, 0.05, 0.2, 0.5, 0.8, 0.95 };
+	const int samples = sizeof(density) / sizeof(density[0]);
+	
+	std::vector<BitString> bsVec;
+	for (int s = 0; s < samples; s++) {
+		bsVec.push_back(BitString(bits));
+		bsVec[s].random(density[s]*bits);
+		bsVec[s].findDist();
+	}
+	
+	std::vector<int> dist;
+	for (Codec codec : codecs) {
+		// Least squares fit of time = perUnit*units + perDist*dists.
+		double uu = 0, ud = 0, dd = 0, ut = 0, dt = 0;
+		for (int s = 0; s < samples; s++) {
+			BitString &bs = bsVec[s];
+			bs.setTaggedDistEnc(codec);
+			int w = (bs.mEncString[0] & 0xFF) >> 3;
+			double payload = bs.mEncBits - AUTO_TAG_BITS;
+			double units;
+			double dists = bs.mOnes + 1;
+			switch (codec) {
+			case CODEC_ACSBS:
+			case CODEC_ACSBS_COMPL:
+				units = payload / w;
+				break;
+			case CODEC_RICE:
+				units = payload - dists*w;
+				break;
+			case CODEC_RICE_COMPL:
+				units = payload - (bits - bs.mOnes + 1)*w;
+				break;
+			default:
+				units = bs.mWords;
+				break;
+			}
+			if (codec == CODEC_ACSBS_COMPL || codec == CODEC_RICE_COMPL) {
+				dists += bits - bs.mOnes + 1;
+			}
+			
+			// Repeat decoding for at least 10ms.
+			int reps = 0;
+			clock_t t = clock();
+			do {
+				bs.getAutoDistEnc(dist);
+				reps++;
+			} while (clock() - t < CLOCKS_PER_SEC / 100);
+			double ns = 1E9*(clock() - t) / CLOCKS_PER_SEC / reps;
+			
+			uu += units*units;
+			ud += units*dists;
+			dd += dists*dists;
+			ut += units*ns;
+			dt += dists*ns;
+		}
+		double det = uu*dd - ud*ud;
+		if (det == 0) continue;
+		double perUnit = (ut*dd - dt*ud) / det;
+		double perDist = (dt*uu - ut*ud) / det;
+		// Negative coefficients mean the other term explains all time.
+		if (perUnit < 0) {
+			perUnit = 0;
+			perDist = dt / dd;
+		} else if (perDist < 0) {
+			perDist = 0;
+			perUnit = ut / uu;
+		}
+		autoCost.perUnit[codec] = perUnit;
+		autoCost.perDist[codec] = perDist;
+	}
+}
+
+void
+BitString::clear()
+{
+	touch();
+	if (!mString) {
+		mDist.assign(1, mBits);
+		findDist();
+		return;
+	}
+	memset(mString, 0, mWords*8);
+	mDist.clear();
+}
+
+bool
+BitString::isSparse() const
+{
+	return !mString;
+}
+
+void
+BitString::setBit(int bit)
+{
+	densify();
+	mString[bit / 64] |= (Word64)1 << (bit % 64);
+	touch();
+}
+
+void
+BitString::clearBit(int bit)
+{
+	densify();
+	mString[bit / 64] &= ~((Word64)1 << (bit % 64));
+	touch();
+}
+
+//! Number of words of XOR processed at once.
+#define XOR_CHUNK_WORDS 256
+
+//! Words [begin, begin + count) of string given by bitmap or distances (*bit and *i
+//! walk the ones of sparse string) are XORed into buffer.
+static void
+xorWords(const Word64 *string, const std::vector<int> &dist, int &bit, int &i, int begin,
+	int count, Word64 *buf)
+{
+	if (string) {
+		for (int w = 0; w < count; w++) buf[w] ^= string[begin + w];
+		return;
+	}
+	int end = 64*(begin + count);
+	while (i < (int)dist.size() - 1 && bit + dist[i] + 1 < end) {
+		bit += dist[i++] + 1;
+		buf[bit / 64 - begin] ^= (Word64)1 << (bit % 64);
+	}
+}
+
+void
+BitString::xorDist(const BitString &bs, std::vector<int> &dist) const
+{
+	Word64 buf[XOR_CHUNK_WORDS];
+	int bit[2] = { -1, -1 };
+	int i[2] = { 0, 0 };
+	int last = -1;
+	
+	dist.clear();
+	for (int begin = 0; begin < mWords; begin += XOR_CHUNK_WORDS) {
+		int count = std::min(XOR_CHUNK_WORDS, mWords - begin);
+		memset(buf, 0, 8*count);
+		xorWords(mString, mDist, bit[0], i[0], begin, count, buf);
+		// Words past the end of shorter string are zero.
+		int words = std::max(0, std::min(count, bs.mWords - begin));
+		xorWords(bs.mString, bs.mDist, bit[1], i[1], begin, words, buf);
+		
+		int ones = kernels().popcount(buf, count);
+		int size = dist.size();
+		dist.resize(size + ones + 1);
+		// Bits past the end of this string are ignored.
+		int bits = std::min(64*count, mBits - 64*begin);
+		last -= 64*begin;
+		size += kernels().findDist(buf, bits, &last, dist.data() + size);
+		last += 64*begin;
+		dist.resize(size);
+	}
+	// The last 'virtual' one.
+	dist.push_back(mBits - last - 1);
+}
+
+void
+BitString::flipDist(const std::vector<int> &dist)
+{
+	densify();
+	
+	// Ones in the same word are flipped at once.
+	int bit = -1;
+	int w = 0;
+	Word64 mask = 0;
+	for (int i = 0; i < (int)dist.size() - 1; i++) {
+		bit += dist[i] + 1;
+		if (bit / 64 != w) {
+			mString[w] ^= mask;
+			w = bit / 64;
+			mask = 0;
+		}
+		mask |= (Word64)1 << (bit % 64);
+	}
+	if (mask) mString[w] ^= mask;
+	touch();
+}
+
+void
+BitString::insertOne(int bit, bool updateEnc)
+{
+	if (!mDistValid) findDist();
+	// Directory finds the one in bitmap without scanning (and is kept up to date).
+	buildRank();
+	int i, prev;
+	locate(bit, i, prev);
+	if (i < mOnes && prev + mDist[i] + 1 == bit) return;
+	
+	// Split distance of the one following the bit.
+	int d = mDist[i];
+	int a = bit - prev - 1;
+	int b = d - a - 1;
+	if (mString) {
+		mString[bit / 64] |= (Word64)1 << (bit % 64);
+		updateRank(bit, 1);
+	}
+	mDist[i] = a;
+	size_t capacity = mDist.capacity();
+	mDist.insert(mDist.begin() + i + 1, b);
+	if (capacity != mDist.capacity()) noteMem();
+	mOnes += 1;
+	
+	updateCost(d, -1);
+	updateCost(a, 1);
+	updateCost(b, 1);
+	
+	dropCache();
+	if (updateEnc) {
+		patchEnc(i, 2, &d, 1);
+	} else {
+		selectWordBits();
+		mEncCodec = CODEC_NONE;
+	}
 }
 
 void
-BitString::setBits(int bits)
+BitString::removeOne(int bit, bool updateEnc)
 {
-	if (mString) delete [] mString;
-	if (mEncString) delete [] mEncString;
-
-	mBits = bits;
-	mOnes = 0;
-	mWords = (bits + 63) / 64;
-	mString = new Word64[mWords];
-	mEncBits = 0;
-	mEncString = new Word64[2*mWords];
-
-	memset(mString, 0, mWords*8);
+	if (!mDistValid) findDist();
+	buildRank();
+	int i, prev;
+	locate(bit, i, prev);
+	if (i == mOnes || prev + mDist[i] + 1 != bit) return;
+	
+	// Merge distances before and after the one.
+	int d[2] = { mDist[i], mDist[i + 1] };
+	if (mString) {
+		mString[bit / 64] &= ~((Word64)1 << (bit % 64));
+		updateRank(bit, -1);
+	}
+	mDist[i] = d[0] + d[1] + 1;
+	mDist.erase(mDist.begin() + i + 1);
+	mOnes -= 1;
+	
+	updateCost(d[0], -1);
+	updateCost(d[1], -1);
+	updateCost(mDist[i], 1);
+	
+	dropCache();
+	if (updateEnc) {
+		patchEnc(i, 1, d, 2);
+	} else {
+		selectWordBits();
+		mEncCodec = CODEC_NONE;
+	}
 }
 
 void
-BitString::random(int k, bool increase)
+BitString::append(int bits, const std::vector<int> &positions)
 {
-	if (increase) {
-		if (mBits < mOnes + k) k = mBits - mOnes;
-	} else {
-		if (mBits < k) k = mBits;
-	}
+	if (!mDistValid) findDist();
+	dropCache();
+	mRankValid = false;
+	int k = positions.size();
+	int v = mDist[mOnes];
+	int begin = mEncBits;
+	bool patch = mEncCodec == CODEC_ACSBS || mEncCodec == CODEC_RICE;
+	if (patch) begin -= codeBits(v);
 	
-	if (increase) {
-		mOnes += k;
-	} else {
-		mOnes = k;
+	// Extend bitmap.
+	if (mString) {
+		resizeBitmap(mBits + bits);
+		for (int i = 0; i < k; i++) {
+			int bit = mBits + positions[i];
+			mString[bit / 64] |= (Word64)1 << (bit % 64);
+		}
 	}
 	
-	mDist.reserve(mOnes + 1);
+	// Replace the 'virtual' distance by new distances.
+	int first = mOnes;
+	int last = -1;
+	updateCost(v, -1);
+	mDist.resize(mOnes + k + 1);
+	for (int i = 0; i < k; i++) {
+		mDist[mOnes + i] = positions[i] - last - 1;
+		last = positions[i];
+	}
+	mDist[first] += v;
+	mDist[mOnes + k] = bits - last - 1 + (k ? 0 : v);
+	mOnes += k;
+	mBits += bits;
+	mWords = (mBits + 63) / 64;
+	noteMem();
+	for (int i = first; i < mOnes + 1; i++) {
+		updateCost(mDist[i], 1);
+	}
 	
-	// Set random bits in string.
-	while (0 < k) {
-		int i = rand() % mBits;
-		if (getBit(i)) continue;
-		setBit(i);
-		k--;
+	if (patch) {
+		appendEnc(begin, first);
+	} else {
+		selectWordBits();
+		mEncCodec = CODEC_NONE;
 	}
 }
 
 void
-BitString::findDist()
+BitString::concat(const BitString &bs)
 {
-	mDist.clear();
+	if (this == &bs) {
+		BitString copy(bs);
+		concat(copy);
+		return;
+	}
 	
-	int d = 0;
-	// Search ones and count distance.
-	for (int i = 0; i < mBits; i++) {
-		if (getBit(i)) {
-			mDist.push_back(d);
-			d = 0;
+	if (!mDistValid) findDist();
+	dropCache();
+	mRankValid = false;
+	int v = mDist[mOnes];
+	int begin = mEncBits;
+	bool patch = (mEncCodec == CODEC_ACSBS || mEncCodec == CODEC_RICE) &&
+		mEncCodec == bs.mEncCodec &&
+		(mEncCodec == CODEC_ACSBS ? mAcsbsBits == bs.mAcsbsBits : mRiceBits == bs.mRiceBits);
+	if (patch) begin -= codeBits(v);
+	
+	// Join bitmaps (sparse string stays sparse).
+	if (mString) {
+		int bits = mBits;
+		resizeBitmap(mBits + bs.mBits);
+		if (bs.mString) {
+			copyBits(mString, bits, bs.mString, 0, bs.mBits);
 		} else {
-			d++;
+			for (int i = 0; i < bs.mOnes; i++) {
+				bits += bs.mDist[i] + 1;
+				mString[(bits - 1) / 64] |= (Word64)1 << ((bits - 1) % 64);
+			}
 		}
 	}
-	// The last 'virtual' one.
-	mDist.push_back(d);
 	
-	// Find optimal word bits for AC-SBS and Rice encodings.
-	findAcsbsWordBits();
-	findRiceWordBits();
+	// Join distances (the 'virtual' one is merged with the first one of bs).
+	int first = mOnes;
+	mDist.resize(mOnes + bs.mOnes + 1);
+	for (int i = 0; i < bs.mOnes + 1; i++) {
+		mDist[mOnes + i] = bs.mDist[i];
+	}
+	mDist[first] += v;
+	
+	// Join encoding sizes.
+	for (int w = 0; w < WORD_BITS_MAX; w++) {
+		mAcsbsCost[w] += bs.mAcsbsCost[w];
+		mRiceCost[w] += bs.mRiceCost[w];
+	}
+	updateCost(v, -1);
+	updateCost(bs.mDist[0], -1);
+	updateCost(mDist[first], 1);
+	mOnes += bs.mOnes;
+	mBits += bs.mBits;
+	mWords = (mBits + 63) / 64;
+	noteMem();
+	
+	if (patch) {
+		// Merged distance and then the rest of bs encoding.
+		int skip = bs.codeBits(bs.mDist[0]);
+		int end = begin + codeBits(mDist[first]) + bs.mEncBits - skip;
+		reserveEnc(end);
+		clearBits(mEncString, begin, mEncBits - begin);
+		if (mEncCodec == CODEC_ACSBS) {
+			begin = acsbsEncode(mDist.data() + first, 1, mAcsbsBits, mEncString, begin);
+		} else {
+			begin = riceEncode(mDist.data() + first, 1, mRiceBits, mEncString, begin);
+		}
+		copyBits(mEncString, begin, bs.mEncString, skip, bs.mEncBits - skip);
+		mEncBits = end;
+		clearEncPad();
+		mEncBlockValid = false;
+		keepWordBits();
+	} else {
+		selectWordBits();
+		mEncCodec = CODEC_NONE;
+	}
 }
 
 void
-BitString::setZlibDistEnc()
+BitString::randomInsert(int k, bool updateEnc)
 {
-	unsigned long size = compressBound((mBits + 7) / 8);
-	compress((unsigned char *)mEncString, &size, (const unsigned char *)mString, (mBits + 7) / 8);
-	mEncBits = 8*size;
+	// Number of ones is out of date after setBit() or clearBit().
+	if (!mDistValid) findDist();
+	if (mBits < mOnes + k) k = mBits - mOnes;
+	
+	// Set random bits in string.
+	while (0 < k) {
+		int i = rand() % mBits;
+		if (mString && getBit(i)) continue;
+		int ones = mOnes;
+		insertOne(i, updateEnc);
+		if (ones == mOnes) continue;
+		k--;
+	}
 }
 
-void
-BitString::setAcsbsDistEnc()
+int
+BitString::getBit(int bit) const
 {
-	memset(mEncString, 0, 8*((mAcsbsEncBits + 63) / 64));
-	mEncBits = 0;
-
-	Word64 m = 0xFFFFFFFFFFFFFFFF >> (64 - mAcsbsBits);
-
-	for (int i = 0; i < mOnes + 1; i++) {
-		int d = mDist[i];
-		while (-1 < d) {
-			Word64 cw = ((Word64)d < m) ? d : m;
-			mEncString[mEncBits / 64] |= cw << (mEncBits % 64);
-			if (64 - (mEncBits % 64) < mAcsbsBits) {
-				mEncBits += mAcsbsBits;
-				mEncString[mEncBits / 64] |= cw >> (mAcsbsBits - mEncBits % 64);
-			} else {
-				mEncBits += mAcsbsBits;
-			}
-			d -= m;
-		}
+	if (!mString) {
+		int i, prev;
+		locate(bit, i, prev);
+		return i < mOnes && prev + mDist[i] + 1 == bit;
 	}
+	return (mString[bit / 64] >> (bit % 64)) & 1;
 }
 
-static std::pair<Word64, int>
-intToRiceEncoding(int dist, int riceBits)
+//! Words of rank/select superblock.
+#define RANK_SUPER_WORDS 32
+//! Words of rank/select block.
+#define RANK_BLOCK_WORDS 8
+//! Ones between select samples.
+#define SELECT_SAMPLE 8192
+//! Distances found at once by encodeDist().
+#define ENCODE_CHUNK_DIST 4096
+//! Distances between kept offsets of code words (for patches of encoding).
+#define ENC_BLOCK_DIST 256
+
+//! Position of the r-th one of word counted from 0 (broadword byte counts select the byte).
+static inline int
+selectWord(Word64 word, int r)
 {
-	std::pair<Word64, int> pr;
-	Word64 word = 0x7FFFFFFFFFFFFFFF;
-	
-	pr.second = riceBits + 1 + (dist >> riceBits);
-	word >>= (63 - (dist >> riceBits));
-	word |= ((Word64)dist & ((1 << riceBits) - 1)) << ((dist >> riceBits) + 1);
-	pr.first = word;
+	Word64 c = word - ((word >> 1) & 0x5555555555555555);
+	c = (c & 0x3333333333333333) + ((c >> 2) & 0x3333333333333333);
+	c = (c + (c >> 4)) & 0x0F0F0F0F0F0F0F0F;
+	// Ones up to every byte, bytes with at most r of them precede the wanted one.
+	Word64 sums = c*0x0101010101010101;
+	Word64 le = ((r*0x0101010101010101 | 0x8080808080808080) - sums) & 0x8080808080808080;
+	int byte = __builtin_popcountll(le);
+	if (byte) r -= (sums >> (8*byte - 8)) & 0xFF;
 	
-	return pr;
+	unsigned int b = (word >> (8*byte)) & 0xFF;
+	for (; 0 < r; r--) b &= b - 1;
+	return 8*byte + __builtin_ctz(b);
 }
 
 void
-BitString::setRiceDistEnc()
+BitString::buildRank()
 {
-	memset(mEncString, 0, 8*((mRiceEncBits + 63) / 64));
-	mEncBits = 0;
+	if (mRankValid || !mString) return;
 	
-	for (int i = 0; i < mOnes + 1; i++) {
-		std::pair<Word64, int> pr = intToRiceEncoding(mDist[i], mRiceBits);
-		mEncString[mEncBits / 64] |= pr.first << (mEncBits % 64);
-		if (64 - (mEncBits % 64) < pr.second) {
-			mEncBits += pr.second;
-			mEncString[mEncBits / 64] |= pr.first >> (pr.second - mEncBits % 64);
-		} else {
-			mEncBits += pr.second;
+	int supers = (mWords + RANK_SUPER_WORDS - 1) / RANK_SUPER_WORDS;
+	mRank.resize(supers + 1);
+	int ones = 0;
+	for (int i = 0; i < supers; i++) {
+		Word64 entry = ones;
+		for (int j = 0; j < RANK_SUPER_WORDS / RANK_BLOCK_WORDS; j++) {
+			int begin = RANK_SUPER_WORDS*i + RANK_BLOCK_WORDS*j;
+			int count = std::max(0, std::min(RANK_BLOCK_WORDS, mWords - begin));
+			int c = kernels().popcount(mString + begin, count);
+			// Count of the last block follows from the next superblock.
+			if (j < 3) entry |= (Word64)c << (32 + 10*j);
+			ones += c;
 		}
+		mRank[i] = entry;
 	}
+	mRank[supers] = ones;
+	findSelectSamples();
+	mRankValid = true;
+	noteMem();
 }
 
 void
-BitString::getZlibDistEnc(std::vector<int> &dist) const
+BitString::updateRank(int bit, int sign)
 {
-	unsigned long size = 8*mWords;
-	Word64 *buf = new Word64[mWords];
-	uncompress((unsigned char *)buf, &size, (const unsigned char *)mEncString, mEncBits / 8);
-	
-	dist.reserve(mOnes + 1);
-	dist.clear();
-	dist.push_back(0);
+	if (!mRankValid) return;
 	
-	int i = 0;
-	int d = 0;
-	for (int bit = 0; bit < 8*(int)size; bit++) {
-		if ((buf[bit / 64] >> (bit % 64)) & 1) {
-			dist[i++] = d;
-			dist.push_back(0);
-			d = 0;
+	// Count of block in its superblock (the last block follows from the next one).
+	int super = bit / (64*RANK_SUPER_WORDS);
+	int block = bit / (64*RANK_BLOCK_WORDS) % (RANK_SUPER_WORDS / RANK_BLOCK_WORDS);
+	if (block < 3) {
+		if (0 < sign) {
+			mRank[super] += (Word64)1 << (32 + 10*block);
 		} else {
-			d += 1;
+			mRank[super] -= (Word64)1 << (32 + 10*block);
 		}
 	}
+	// Ones before the following superblocks (counts are at least one when removing).
+	for (int i = super + 1; i < (int)mRank.size(); i++) {
+		mRank[i] += sign;
+	}
 	
-	dist.pop_back();
-	delete [] buf;
+	// Select samples drift by a superblock at most per change, select() steps over it.
+	if (++mRankEdits > (int)mRank.size()) findSelectSamples();
 }
 
 void
-BitString::getAcsbsDistEnc(std::vector<int> &dist) const
+BitString::findSelectSamples()
 {
-	int m = 0xFFFFFFFF >> (32 - mAcsbsBits);
-	const Word32 *enc = (const Word32*)mEncString;
-
-	dist.reserve(mOnes + 1);
-	dist.clear();
-	dist.push_back(0);
-
-	int i = 0;
-	for (int bit = 0; bit < mEncBits; bit += mAcsbsBits) {
-		int d = (*(const Word64*)(enc + (bit / 32)) >> (bit % 32)) & m;
-		dist[i] += d;
-		if (d != m) {
-			dist.push_back(0);
-			i += 1 ;
-		}
+	mSelect.clear();
+	for (int i = 0; i + 1 < (int)mRank.size(); i++) {
+		int ones = (Word32)mRank[i + 1];
+		while ((int64_t)SELECT_SAMPLE*(int64_t)mSelect.size() < ones) mSelect.push_back(i);
 	}
-	
-	dist.pop_back();
+	mRankEdits = 0;
 }
 
 void
-BitString::getRiceDistEnc(std::vector<int> &dist) const
+BitString::clearRank()
 {
-	int m = 1 << mRiceBits;
-	const Word32 *enc = (const Word32*)mEncString;
+	mRankValid = false;
+}
 
-	dist.reserve(mOnes + 1);
-	dist.clear();
-	dist.push_back(0);
+bool
+BitString::hasRank() const
+{
+	return mRankValid;
+}
 
-	int i = 0;
-	int bit = 0;
-	while (bit < mEncBits) {
-		Word64 word = (*(const Word64*)(enc + (bit / 32)) >> (bit % 32));
-		// Count ones.
-		while (word & 1) {
-			dist[i] += m;
-			word >>= 1;
-			bit += 1;
-		}
-		// Skip zero.
-		word >>= 1;
-		bit += 1;
-		// Decode remainder.
-		dist[i] += word & (m - 1);
-		bit += mRiceBits;
-		// Set next distance.
-		dist.push_back(0);
-		i += 1;
+int
+BitString::rank(int bit) const
+{
+	if (!mString) {
+		int i, prev;
+		locate(bit, i, prev);
+		return i;
 	}
+	if (!mRankValid) return countOnes(bit);
 	
-	dist.pop_back();
+	int i = bit / (64*RANK_SUPER_WORDS);
+	Word64 entry = mRank[i];
+	int ones = (Word32)entry;
+	int block = bit / (64*RANK_BLOCK_WORDS) % (RANK_SUPER_WORDS / RANK_BLOCK_WORDS);
+	for (int j = 0; j < block; j++) ones += (entry >> (32 + 10*j)) & 0x3FF;
+	for (int w = bit / (64*RANK_BLOCK_WORDS)*RANK_BLOCK_WORDS; w < bit / 64; w++) {
+		ones += __builtin_popcountll(mString[w]);
+	}
+	if (bit % 64) ones += __builtin_popcountll(mString[bit / 64] << (64 - bit % 64));
+	return ones;
 }
 
-void
-BitString::clear()
+int
+BitString::select(int i) const
 {
-	memset(mString, 0, mWords*8);
-	mDist.clear();
+	if (i < 0 || getOnes() <= i) return -1;
+	if (!mString) {
+		int bit = -1;
+		for (int j = 0; j <= i; j++) bit += mDist[j] + 1;
+		return bit;
+	}
+	
+	int w = 0;
+	if (mRankValid) {
+		// The last superblock with at most i ones before it (between samples).
+		int s = i / SELECT_SAMPLE;
+		int samples = mSelect.size();
+		int lo = s < samples ? mSelect[s] : (samples ? mSelect[samples - 1] : 0);
+		int hi = s + 1 < samples ? mSelect[s + 1] + 1 : mRank.size() - 1;
+		// Samples may lag behind changes of insertOne() and removeOne().
+		while (0 < lo && i < (int)(Word32)mRank[lo]) lo--;
+		while (hi < (int)mRank.size() - 1 && (int)(Word32)mRank[hi] <= i) hi++;
+		while (1 < hi - lo) {
+			int mid = (lo + hi) / 2;
+			if ((int)(Word32)mRank[mid] <= i) lo = mid; else hi = mid;
+		}
+		Word64 entry = mRank[lo];
+		i -= (Word32)entry;
+		int block = 0;
+		for (; block < 3; block++) {
+			int c = (entry >> (32 + 10*block)) & 0x3FF;
+			if (i < c) break;
+			i -= c;
+		}
+		w = RANK_SUPER_WORDS*lo + RANK_BLOCK_WORDS*block;
+	}
+	for (int c; (c = __builtin_popcountll(mString[w])) <= i; w++) i -= c;
+	return 64*w + selectWord(mString[w], i);
 }
 
-void
-BitString::setBit(int bit)
+int
+BitString::getDist(int first, int count, int *dist) const
 {
-	mString[bit / 64] |= (Word64)1 << (bit % 64);
+	int ones = getOnes();
+	if (first < 0 || ones < first || count <= 0) return 0;
+	if (ones + 1 - first < count) count = ones + 1 - first;
+	if (mDistValid) {
+		memcpy(dist, mDist.data() + first, 4*count);
+		return count;
+	}
+	
+	// Bitmap from the previous one to the last one of range.
+	int prev = first ? select(first - 1) : -1;
+	bool virt = first + count == ones + 1;
+	int end = virt ? mBits : select(first + count - 1) + 1;
+	int n = 0;
+	if (prev + 1 < end) {
+		int w = (prev + 1) / 64;
+		Word64 word = mString[w] & (0xFFFFFFFFFFFFFFFF << ((prev + 1) % 64));
+		if (end < 64*(w + 1)) word &= 0xFFFFFFFFFFFFFFFF >> (64*(w + 1) - end);
+		for (; word; word &= word - 1) {
+			int bit = 64*w + __builtin_ctzll(word);
+			dist[n++] = bit - prev - 1;
+			prev = bit;
+		}
+		// Whole words after the first one.
+		if (64*(w + 1) < end) {
+			int last = prev - 64*(w + 1);
+			n += kernels().findDist(mString + w + 1, end - 64*(w + 1), &last, dist + n);
+			prev = last + 64*(w + 1);
+		}
+	}
+	// The last 'virtual' one.
+	if (virt) dist[n++] = mBits - prev - 1;
+	return n;
 }
 
 int
-BitString::getBit(int bit) const
+BitString::encodeDist(Codec codec, int wordBits, int first, int count, Word64 *enc,
+	int encBits) const
 {
-	return (mString[bit / 64] >> (bit % 64)) & 1;
+	static thread_local std::vector<int> dist(ENCODE_CHUNK_DIST);
+	while (0 < count) {
+		int n = getDist(first, std::min(count, ENCODE_CHUNK_DIST), dist.data());
+		if (!n) break;
+		if (codec == CODEC_ACSBS) {
+			encBits = acsbsEncode(dist.data(), n, wordBits, enc, encBits);
+		} else {
+			encBits = riceEncode(dist.data(), n, wordBits, enc, encBits);
+		}
+		first += n;
+		count -= n;
+	}
+	return encBits;
 }
 
 void
@@ -320,44 +2080,353 @@ BitString::printDist(const std::vector<int> &dist, const char *begin, const char
 
 void
 BitString::findAcsbsWordBits()
+{
+	// Fixed coode word compression size.
+	kernels().acsbsCost(mDist.data(), mOnes + 1, mAcsbsCost);
+}
+
+void
+BitString::findRiceWordBits()
+{
+	// Rice-Golomb compression size.
+	kernels().riceCost(mDist.data(), mOnes + 1, mRiceCost);
+}
+
+void
+BitString::clearEnc()
+{
+	mEncCodec = CODEC_NONE;
+	dropCache();
+}
+
+void
+BitString::touch()
+{
+	mDistValid = false;
+	mRankValid = false;
+	mEncCodec = CODEC_NONE;
+	dropCache();
+}
+
+void
+BitString::dropCache()
+{
+	for (int c = 0; c < CODEC_COUNT; c++) mEncCache[c].valid = false;
+	mAutoCodec = CODEC_NONE;
+}
+
+void
+BitString::dropEnc(Codec codec)
+{
+	mEncCache[codec].valid = false;
+	if (mEncCodec == codec) mEncCodec = CODEC_NONE;
+	if (codec == CODEC_ACSBS || codec == CODEC_RICE) mAutoCodec = CODEC_NONE;
+}
+
+bool
+BitString::useEnc(Codec codec)
+{
+	if (!mDistValid) findDist();
+	if (mEncCodec == codec) return true;
+	mEncBlockValid = false;
+	
+	// Keep current encoding (its slot gives back the previous buffer).
+	if (mEncCodec != CODEC_NONE) {
+		EncCache &old = mEncCache[mEncCodec];
+		std::swap(old.string, mEncString);
+		std::swap(old.words, mEncWords);
+		old.bits = mEncBits;
+		old.valid = true;
+	}
+	
+	// Take kept encoding or at least its buffer.
+	EncCache &cache = mEncCache[codec];
+	bool valid = cache.valid;
+	if (cache.string) {
+		std::swap(cache.string, mEncString);
+		std::swap(cache.words, mEncWords);
+		mEncBits = cache.bits;
+	}
+	cache.valid = false;
+	if (!mEncString) {
+		mEncWords = 1;
+		mEncString = new Word64[mEncWords];
+		mEncString[0] = 0;
+		noteMem();
+	}
+	mEncCodec = valid ? codec : CODEC_NONE;
+	return valid;
+}
+
+const Word64 *
+BitString::getEnc(Codec codec, int &bits) const
+{
+	if (mEncCodec == codec) {
+		bits = mEncBits;
+		return mEncString;
+	}
+	if (mEncCache[codec].valid) {
+		bits = mEncCache[codec].bits;
+		return mEncCache[codec].string;
+	}
+	bits = 0;
+	return mEncString;
+}
+
+void
+BitString::selectWordBits()
 {
 	mAcsbsBits = 1;
-	mAcsbsEncBits = mBits + 1;
+	mAcsbsEncBits = mAcsbsCost[1];
+	mRiceBits = 0;
+	mRiceEncBits = mRiceCost[0];
 	
-	// Fixed coode word compression size.
+	// Check for optimal code word bits.
 	for (int w = 1; w < WORD_BITS_MAX; w++) {
-		int m = (1 << w) - 1;
-		int bits = 0;
-		for (int k = 0; k < mOnes + 1; k++) {
-			bits += w*((mDist[k] / m) + 1);
-		}
-		// Check for optimal code word bits.
-		if (bits < mAcsbsEncBits) {
+		if (mAcsbsCost[w] < mAcsbsEncBits) {
 			mAcsbsBits = w;
-			mAcsbsEncBits = bits;
+			mAcsbsEncBits = mAcsbsCost[w];
+		}
+		if (mRiceCost[w] < mRiceEncBits) {
+			mRiceBits = w;
+			mRiceEncBits = mRiceCost[w];
 		}
 	}
 }
 
 void
-BitString::findRiceWordBits()
+BitString::updateCost(int d, int sign)
 {
-	mRiceBits = 1;
-	mRiceEncBits = mBits + 1;
-
-	// Rice-Golomb compression size.
+	for (int w = 1; w < WORD_BITS_MAX; w++) {
+		mAcsbsCost[w] += sign*acsbsCodeBits(d, w);
+	}
 	for (int w = 0; w < WORD_BITS_MAX; w++) {
-		int m = 1 << w;
-		int bits = 0;
-		for (int k = 0; k < mOnes + 1; k++) {
-			bits += (mDist[k] / m) + 1 + w;
+		mRiceCost[w] += sign*riceCodeBits(d, w);
+	}
+}
+
+void
+BitString::locate(int bit, int &i, int &prev) const
+{
+	if (mString) {
+		i = countOnes(bit);
+		prev = prevOne(bit);
+		return;
+	}
+	
+	// Walk distances of sparse string.
+	prev = -1;
+	for (i = 0; i < mOnes; i++) {
+		int next = prev + mDist[i] + 1;
+		if (bit <= next) return;
+		prev = next;
+	}
+}
+
+int
+BitString::countOnes(int bit) const
+{
+	if (mRankValid) return rank(bit);
+	int ones = 0;
+	for (int i = 0; i < bit / 64; i++) {
+		ones += __builtin_popcountll(mString[i]);
+	}
+	if (bit % 64) {
+		ones += __builtin_popcountll(mString[bit / 64] << (64 - bit % 64));
+	}
+	return ones;
+}
+
+int
+BitString::prevOne(int bit) const
+{
+	if (mRankValid) {
+		int ones = rank(bit);
+		return ones ? select(ones - 1) : -1;
+	}
+	int i = bit / 64;
+	Word64 word = (bit % 64) ? mString[i] << (64 - bit % 64) : 0;
+	if (word) return bit - 1 - __builtin_clzll(word);
+	while (0 < i--) {
+		if (mString[i]) return 64*i + 63 - __builtin_clzll(mString[i]);
+	}
+	return -1;
+}
+
+void
+BitString::patchEnc(int first, int count, const int *dist, int oldCount)
+{
+	// Stale encodings of other kinds are dropped.
+	if (mEncCodec != CODEC_ACSBS && mEncCodec != CODEC_RICE) {
+		mEncCodec = CODEC_NONE;
+		return;
+	}
+	
+	int acsbsBits = mAcsbsBits;
+	int riceBits = mRiceBits;
+	selectWordBits();
+	
+	// Change of optimal code word requires encoding from scratch.
+	if (mEncCodec == CODEC_ACSBS && acsbsBits != mAcsbsBits) {
+		mEncCodec = CODEC_NONE;
+		setAcsbsDistEnc();
+		return;
+	}
+	if (mEncCodec == CODEC_RICE && riceBits != mRiceBits) {
+		mEncCodec = CODEC_NONE;
+		setRiceDistEnc();
+		return;
+	}
+	
+	// Position and sizes of replaced code words (offsets of blocks up to the first
+	// distance do not depend on the patch).
+	bool blocks = mEncBlockValid;
+	int begin = encOffset(first);
+	int oldBits = 0;
+	int newBits = 0;
+	for (int i = 0; i < oldCount; i++) {
+		oldBits += codeBits(dist[i]);
+	}
+	for (int i = first; i < first + count; i++) {
+		newBits += codeBits(mDist[i]);
+	}
+	
+	// Move the rest of the stream and write new code words.
+	int end = mEncBits + newBits - oldBits;
+	reserveEnc(end);
+	moveBits(mEncString, begin + oldBits, begin + newBits, mEncBits - begin - oldBits);
+	clearBits(mEncString, begin, newBits);
+	if (end < mEncBits) clearBits(mEncString, end, mEncBits - end);
+	if (mEncCodec == CODEC_ACSBS) {
+		acsbsEncode(mDist.data() + first, count, mAcsbsBits, mEncString, begin);
+	} else {
+		riceEncode(mDist.data() + first, count, mRiceBits, mEncString, begin);
+	}
+	mEncBits = end;
+	clearEncPad();
+	if (blocks) {
+		updateEncBlocks(first, count, dist, oldCount, newBits - oldBits);
+	} else {
+		// Offsets found above are of patched distances, find them once more.
+		mEncBlockValid = false;
+		encOffset(0);
+	}
+}
+
+int
+BitString::encOffset(int first)
+{
+	int blocks = (mOnes + ENC_BLOCK_DIST) / ENC_BLOCK_DIST;
+	if (!mEncBlockValid) {
+		size_t capacity = mEncBlock.capacity();
+		mEncBlock.resize(blocks);
+		int bit = 0;
+		for (int i = 0; i < mOnes + 1; i++) {
+			if (i % ENC_BLOCK_DIST == 0) mEncBlock[i / ENC_BLOCK_DIST] = bit;
+			bit += codeBits(mDist[i]);
 		}
-		// Check for optimal code word bits.
-		if (bits < mRiceEncBits) {
-			mRiceBits = w;
-			mRiceEncBits = bits;
+		if (capacity != mEncBlock.capacity()) noteMem();
+		mEncBlockValid = true;
+	}
+	
+	int bit = mEncBlock[first / ENC_BLOCK_DIST];
+	for (int i = first - first % ENC_BLOCK_DIST; i < first; i++) {
+		bit += codeBits(mDist[i]);
+	}
+	return bit;
+}
+
+void
+BitString::updateEncBlocks(int first, int count, const int *dist, int oldCount, int delta)
+{
+	if (!mEncBlockValid) return;
+	
+	// Old distance at index y (distances after the patch are shifted).
+	int shift = count - oldCount;
+	auto oldAt = [&](int y) {
+		return (y < first + oldCount) ? dist[y - first] : mDist[y + shift];
+	};
+	
+	int oldBlocks = mEncBlock.size();
+	int blocks = (mOnes + ENC_BLOCK_DIST) / ENC_BLOCK_DIST;
+	size_t capacity = mEncBlock.capacity();
+	mEncBlock.resize(blocks);
+	for (int j = first / ENC_BLOCK_DIST + 1; j < blocks; j++) {
+		int x = j*ENC_BLOCK_DIST;
+		if (x < first + count || oldBlocks <= j) {
+			// Block starts within new distances (or is new), sum the previous block.
+			int bit = mEncBlock[j - 1];
+			for (int i = x - ENC_BLOCK_DIST; i < x; i++) bit += codeBits(mDist[i]);
+			mEncBlock[j] = bit;
+			continue;
 		}
+		// Old offset of the same distance (shift distances away) moved by delta.
+		int bit = mEncBlock[j] + delta;
+		for (int y = x - shift; y < x; y++) bit -= codeBits(oldAt(y));
+		for (int y = x; y < x - shift; y++) bit += codeBits(oldAt(y));
+		mEncBlock[j] = bit;
+	}
+	if (capacity != mEncBlock.capacity()) noteMem();
+}
+
+void
+BitString::appendEnc(int begin, int first)
+{
+	int end = begin;
+	for (int i = first; i < mOnes + 1; i++) {
+		end += codeBits(mDist[i]);
+	}
+	
+	reserveEnc(end);
+	clearBits(mEncString, begin, mEncBits - begin);
+	if (mEncCodec == CODEC_ACSBS) {
+		acsbsEncode(mDist.data() + first, mOnes + 1 - first, mAcsbsBits, mEncString, begin);
+	} else {
+		riceEncode(mDist.data() + first, mOnes + 1 - first, mRiceBits, mEncString, begin);
+	}
+	mEncBits = end;
+	clearEncPad();
+	mEncBlockValid = false;
+	keepWordBits();
+}
+
+void
+BitString::keepWordBits()
+{
+	int acsbsBits = mAcsbsBits;
+	int riceBits = mRiceBits;
+	selectWordBits();
+	
+	// Code word bits of current encoding do not change.
+	if (mEncCodec == CODEC_ACSBS) {
+		mAcsbsBits = acsbsBits;
+		mAcsbsEncBits = mAcsbsCost[acsbsBits];
+	} else if (mEncCodec == CODEC_RICE) {
+		mRiceBits = riceBits;
+		mRiceEncBits = mRiceCost[riceBits];
+	}
+}
+
+void
+BitString::resizeBitmap(int bits)
+{
+	int words = (bits + 63) / 64;
+	// Old and new bitmap are held at once while copying.
+	noteMem(8*words);
+	Word64 *str = new Word64[words];
+	memcpy(str, mString, 8*(mWords < words ? mWords : words));
+	if (mWords < words) memset(str + mWords, 0, 8*(words - mWords));
+	delete [] mString;
+	mString = str;
+}
+
+int
+BitString::codeBits(int d) const
+{
+	if (mEncCodec == CODEC_ACSBS) {
+		return acsbsCodeBits(d, mAcsbsBits);
 	}
+	return riceCodeBits(d, mRiceBits);
 }
 
 int
@@ -1,6 +1,8 @@
 #ifndef __COMPRESS_H__
 #define __COMPRESS_H__
 
+#include "memstat.h"
+
 #include <cstdint>
 #include <vector>
 
@@ -14,44 +16,202 @@ typedef uint32_t Word32;
 #define WORD_BITS_MAX 30
 #endif
 
+//! ZLIB DEFLATE strategies (values match Z_XXX constants from zlib.h).
+enum ZlibStrategy
+{
+	ZLIB_DEFAULT = 0,
+	ZLIB_FILTERED = 1,
+	ZLIB_HUFFMAN_ONLY = 2,
+	ZLIB_RLE = 3,
+	ZLIB_FIXED = 4
+};
+
+//! Encodings of binary string (values up to 7 fit the tag of automatic encoding).
+enum Codec
+{
+	CODEC_NONE = 0,
+	CODEC_ACSBS = 1,
+	CODEC_RICE = 2,
+	CODEC_ZLIB = 3,
+	CODEC_RAW = 4,
+	CODEC_ACSBS_COMPL = 5,
+	CODEC_RICE_COMPL = 6,
+	CODEC_AUTO = 7,
+	CODEC_ACSBS_RUNS = 8,
+	CODEC_COUNT = 9
+};
+
+//! Encoding kept while another one is in use.
+struct EncCache
+{
+	//! Encoding (null if never allocated).
+	Word64 *string;
+	//! Number of 64-bit words allocated for encoding.
+	int words;
+	//! Bit length of encoding.
+	int bits;
+	//! Encoding matches current distances.
+	bool valid;
+};
+
 //! Class for binary string.
 class BitString
 {
 public:
 	//! Zero bitsring with given length.
 	BitString(int bits = 10000);
+	//! Sparse bitstring with ones at given sorted positions (no bitmap is allocated).
+	BitString(int bits, const std::vector<int> &positions);
+	//! Sparse bitstring with given distances between ones (no bitmap is allocated).
+	BitString(const std::vector<int> &dist);
 	//! Bitstring copy constructor.
 	BitString(const BitString &bs);
 	//! Bitstring destructor.
 	~BitString();
+	//! Bitstring assignment.
+	BitString &operator=(const BitString &bs);
 
 	//! Change sice of bitstring length.
 	void setBits(int bits);
+	//! Replace bitstring by sparse one with ones at given sorted positions.
+	void setPositions(int bits, const std::vector<int> &positions);
+	//! Replace bitstring by sparse one with given distances (including the 'virtual' one).
+	void setDist(const std::vector<int> &dist);
+	//! Replace bitstring by copy of packed bits (least significant bit of byte first).
+	void setPacked(int bits, const void *data);
 
 	//! Set k ones in string at random.
 	void random(int k, bool increase = false);
-	//! Determine distances between ones.
+	//! Set k ones in string at random in runs of given mean length.
+	void randomRuns(int k, int run, bool increase = false);
+	//! Extend string by given bits with ones at sorted positions (relative to the old end).
+	//! Current AC-SBS or Rice-Golomb encoding is extended without re-encoding
+	//! (its code word bits are kept, findDist() finds optimal ones again).
+	void append(int bits, const std::vector<int> &positions);
+	//! Append another string (with known distances). Encodings of the same kind and
+	//! code word bits are spliced without re-encoding, otherwise encoding is dropped.
+	void concat(const BitString &bs);
+	//! Set k more ones at random updating distances incrementally (see insertOne()).
+	void randomInsert(int k, bool updateEnc = false);
+	//! Determine distances between ones (encoders do it on their own after bitmap changes).
 	void findDist();
-	//! Compress using Lempel-Ziv (ZLIB DEFLATE).
+	//! Select ZLIB compression level (-1 is zlib default, 0..9) and strategy.
+	void setZlibParams(int level, ZlibStrategy strategy = ZLIB_DEFAULT);
+	//! Compress using Lempel-Ziv (ZLIB DEFLATE). Encodings of all codecs are kept until
+	//! the string changes, so repeated setXxxDistEnc() only switches to the kept one.
 	void setZlibDistEnc();
 	//! Compress using AC-SBS.
 	void setAcsbsDistEnc();
 	//! Compress using Rice-Golomb.
 	void setRiceDistEnc();
+	//! Compress (zero-run, one-run) pairs using AC-SBS with own word bits for each.
+	void setRunDistEnc();
+	//! Compress using the best of AC-SBS, Rice-Golomb, raw and complement encodings.
+	void setAutoDistEnc();
+	//! Compress using given codec prefixed with one-byte tag (as setAutoDistEnc() does).
+	void setTaggedDistEnc(Codec codec);
 
-	//! Decompress using Lempel-Ziv (ZLIB DEFLATE).
+	//! Drop current and kept encodings (the next setXxxDistEnc() encodes again).
+	void clearEnc();
+
+	//! Decompress using Lempel-Ziv (ZLIB DEFLATE). Decoders use encoding of their codec
+	//! kept by the last setXxxDistEnc() even if another encoding is in use now.
 	void getZlibDistEnc(std::vector<int> &dist) const;
-	//! Decompress using AC-SBS.
-	void getAcsbsDistEnc(std::vector<int> &dist) const;
-	//! Decompress using Rice-Golomb.
-	void getRiceDistEnc(std::vector<int> &dist) const;
+	//! Decompress using AC-SBS (false for malformed encoding, padded buffer is never
+	//! read past, only the final block of code words is checked).
+	bool getAcsbsDistEnc(std::vector<int> &dist) const;
+	//! Decompress using Rice-Golomb (false for malformed encoding).
+	bool getRiceDistEnc(std::vector<int> &dist) const;
+	//! Decompress run-pair AC-SBS (distances in runs of ones are filled at once), false
+	//! for malformed encoding (e.g. run past the end of string).
+	bool getRunDistEnc(std::vector<int> &dist) const;
+	//! Decompress run-pair AC-SBS into bitmap words (runs of ones are filled by words),
+	//! false for malformed encoding.
+	bool getRunBitsEnc(std::vector<Word64> &words) const;
+	//! Decompress tagged encoding (see setAutoDistEnc()), false for malformed encoding.
+	bool getAutoDistEnc(std::vector<int> &dist) const;
+	//! Decompress tagged encoding of string with given bits and ones held elsewhere
+	//! (padded by DECODE_PAD_WORDS words), false for malformed encoding.
+	static bool getTaggedDist(const Word64 *enc, int encBits, int bits, int ones,
+		std::vector<int> &dist);
+	//! Decompress AC-SBS encodings of many strings interleaved (dist[i] must have room
+	//! for bs[i]->getOnes() + 1 distances, false if some encoding is malformed).
+	static bool getAcsbsDistEncBatch(const BitString *const *bs, int count, int *const *dist);
+	//! Decompress Rice-Golomb encodings of many strings interleaved (dist[i] must have room
+	//! for bs[i]->getOnes() + 1 distances, false if some encoding is malformed).
+	static bool getRiceDistEncBatch(const BitString *const *bs, int count, int *const *dist);
+
+	//! Number of bits in string.
+	int getBits() const;
+	//! Number of ones in string.
+	int getOnes() const;
+	//! Check if distances match bitmap (no bitmap change since findDist()).
+	bool isDistValid() const;
+	//! Size of current encoding in bits.
+	int getEncBits() const;
+	//! Codec of current encoding (codec from tag for automatic encoding).
+	Codec getEncCodec() const;
+	//! Encoding of given codec, current or kept (bits receives its length, 0 if none).
+	const Word64 *getEnc(Codec codec, int &bits) const;
+	//! Memory held by string: bitmap, encoding buffers (current and kept), distances and
+	//! rank/select directory, unused part is capacity beyond content.
+	MemUsage getMemUsage() const;
+	//! Start peak of memory from memory held now.
+	void resetMemPeak();
+
+	//! Set how many bits of encoding are worth one nanosecond of decoding time.
+	static void setAutoCostWeight(double bitsPerNs);
+	//! Measure decoding time model used by setAutoDistEnc() on this machine.
+	static void calibrateAutoCost(int bits = 100000);
+	//! Number of threads of distance extraction in findDist() (0 for all cores).
+	static void setThreads(int threads);
 
 	//! Set all bits to zero.
 	void clear();
-	//! Set given bit to one.
+	//! Check if bitstring is kept only as distances (without bitmap).
+	bool isSparse() const;
+	//! Set given bit to one (distances and encodings are out of date then).
 	void setBit(int bit);
-	//! Get valu of given bit.
+	//! Set given bit to zero (distances and encodings are out of date then).
+	void clearBit(int bit);
+	//! Set given bit to one and update distances and code word bits (needs findDist()).
+	//! Current AC-SBS or Rice-Golomb encoding is patched in place if updateEnc is set.
+	//! The one is found by rank/select directory (built by the first call on bitmap and
+	//! kept up to date) and code words by offsets of blocks of ENC_BLOCK_DIST distances.
+	//! Distances, encoding after the patch and directory counts are still shifted
+	//! (word-wise moves, O(k + n/2048)), but nothing is scanned or re-encoded.
+	void insertOne(int bit, bool updateEnc = false);
+	//! Set given bit to zero and update distances and code word bits (needs findDist()).
+	//! Current AC-SBS or Rice-Golomb encoding is patched in place if updateEnc is set
+	//! (see insertOne()).
+	void removeOne(int bit, bool updateEnc = false);
+	//! Get valu of given bit (O(k) for sparse string).
 	int getBit(int bit) const;
+	//! Build rank/select directory of bitmap: ones before every 2048 bits and in their
+	//! 512-bit blocks packed into one word (about 3% of bitmap), dropped by bitmap changes.
+	void buildRank();
+	//! Drop rank/select directory (the next buildRank() builds it again).
+	void clearRank();
+	//! Check if rank/select directory is up to date.
+	bool hasRank() const;
+	//! Number of ones before given bit (O(1) with directory, otherwise scan).
+	int rank(int bit) const;
+	//! Position of the i-th one counted from 0, -1 if there is not (near O(1) with directory).
+	int select(int i) const;
+	//! Distances of count ones from the first one on (the first one is measured from the
+	//! previous one, the 'virtual' one counts), found from bitmap if distances are out of
+	//! date, returns number of distances.
+	int getDist(int first, int count, int *dist) const;
+	//! Write AC-SBS or Rice-Golomb code words of count distances from the first one on
+	//! to zeroed bits from encBits on, returns end bit. Encoding can be built by parts
+	//! while bitmap answers rank/select queries.
+	int encodeDist(Codec codec, int wordBits, int first, int count, Word64 *enc,
+		int encBits) const;
+	//! Distances between ones of XOR with another string (word by word, needs distances
+	//! of sparse strings, bits past the end of the shorter string are zero).
+	void xorDist(const BitString &bs, std::vector<int> &dist) const;
+	//! Flip bits at ones given by distances word by word (needs findDist() then).
+	void flipDist(const std::vector<int> &dist);
 
 	//! Print binary string.
 	void print(const char *begin = "", const char *end = "\n") const;
@@ -67,10 +227,64 @@ public:
 		const char *end = "\n");
 
 protected:
-	//! Determine optimal AC-SBS word bits for the string.
+	//! Copy another string (bitmap, distances and encoding).
+	void copy(const BitString &bs);
+	//! Mark distances and all encodings as out of date (bitmap changed).
+	void touch();
+	//! Drop all kept encodings except the current one.
+	void dropCache();
+	//! Drop encoding of given codec (kept or current).
+	void dropEnc(Codec codec);
+	//! Switch to encoding of given codec, true if it is kept and valid (otherwise
+	//! encoder has to fill current encoding). Out of date distances are found first.
+	bool useEnc(Codec codec);
+	//! Determine AC-SBS encoding sizes for all word bits.
 	void findAcsbsWordBits();
-	//! Determine optimal Rice-Golomb word bits for the string.
+	//! Find distances and encoding sizes of bitmap by chunks in given number of threads.
+	void findDistParallel(int threads);
+	//! Determine Rice-Golomb encoding sizes for all word bits.
 	void findRiceWordBits();
+	//! Select optimal word bits from encoding sizes by word bits.
+	void selectWordBits();
+	//! Add (sign 1) or remove (sign -1) distance from encoding sizes by word bits.
+	void updateCost(int d, int sign);
+	//! Drop bitmap and keep string as distances only.
+	void setSparse(int bits);
+	//! Build bitmap of sparse string from distances.
+	void densify();
+	//! Make room for encoding of given length.
+	void reserveEnc(int bits);
+	//! Zero bits past the end of current encoding up to the end of decoder padding
+	//! (reused buffer may hold longer encoding).
+	void clearEncPad();
+	//! Update peak of memory after change of buffers (extra bytes are held meanwhile).
+	void noteMem(int64_t extra = 0);
+	//! Index of distance containing given bit and position of the previous one.
+	void locate(int bit, int &i, int &prev) const;
+	//! Number of ones before given bit.
+	int countOnes(int bit) const;
+	//! Position of the last one before given bit (-1 if none).
+	int prevOne(int bit) const;
+	//! Replace code words of oldCount distances by count distances starting at first.
+	void patchEnc(int first, int count, const int *dist, int oldCount);
+	//! Bit of code words of given distance in current encoding (offsets of blocks are
+	//! found first if out of date).
+	int encOffset(int first);
+	//! Move offsets of blocks after code words of oldCount distances dist at first were
+	//! replaced by count distances (delta is change of their bits).
+	void updateEncBlocks(int first, int count, const int *dist, int oldCount, int delta);
+	//! Add (sign 1) or remove (sign -1) one at given bit from rank/select directory.
+	void updateRank(int bit, int sign);
+	//! Superblocks of every SELECT_SAMPLE-th one from directory counts.
+	void findSelectSamples();
+	//! Encode distances from first on at given bit of current encoding.
+	void appendEnc(int begin, int first);
+	//! Select optimal word bits except the ones used by current encoding.
+	void keepWordBits();
+	//! Change size of bitmap (new bits are zero).
+	void resizeBitmap(int bits);
+	//! Bits of code words of single distance in current encoding.
+	int codeBits(int d) const;
 	//! Get encoding bits.
 	int getEncBit(int bit) const;
 
@@ -81,11 +295,23 @@ private:
 	int mOnes;
 	//! Number of 64-bit words in string.
 	int mWords;
-	//! String in packed form.
+	//! String in packed form (null for sparse string).
 	Word64 *mString;
 	
+	//! Rank/select directory: ones before superblock (low 32 bits) and ones in its
+	//! first three blocks (10 bits each) for every superblock and the end.
+	std::vector<Word64> mRank;
+	//! Superblock of every SELECT_SAMPLE-th one.
+	std::vector<int> mSelect;
+	//! Directory matches bitmap.
+	bool mRankValid;
+	//! Changes of directory since select samples were found.
+	int mRankEdits;
+	
 	//! Vector containing distances between ones.
 	std::vector<int> mDist;
+	//! Distances match bitmap.
+	bool mDistValid;
 	//! Code word bit size for AC-SBS.
 	int mAcsbsBits;
 	//! Bit length of the AC-SBS encoding.
@@ -94,10 +320,36 @@ private:
 	int mRiceBits;
 	//! Bit length of the Rice-Golomb encoding.
 	int mRiceEncBits;
+	//! Run-pair AC-SBS code word bits of runs of zeros.
+	int mRunZeroBits;
+	//! Run-pair AC-SBS code word bits of runs of ones.
+	int mRunOneBits;
+	//! Bit length of the AC-SBS encoding by code word bits.
+	int mAcsbsCost[WORD_BITS_MAX];
+	//! Bit length of the Rice-Golomb encoding by code word bits.
+	int mRiceCost[WORD_BITS_MAX];
+	//! ZLIB compression level.
+	int mZlibLevel;
+	//! ZLIB compression strategy.
+	ZlibStrategy mZlibStrategy;
+	//! Last used encoding algorithm.
+	Codec mEncCodec;
 	//! Bit length of the last used encoding algorithm.
 	int mEncBits;
+	//! Number of 64-bit words allocated for encoding.
+	int mEncWords;
 	//! Encoding of the last used algorithm.
 	Word64 *mEncString;
+	//! Encodings of other codecs kept for later use.
+	EncCache mEncCache[CODEC_COUNT];
+	//! Bit of code words of every ENC_BLOCK_DIST-th distance in current encoding.
+	std::vector<int> mEncBlock;
+	//! Offsets of blocks match current encoding.
+	bool mEncBlockValid;
+	//! Codec chosen by the last automatic selection (none if out of date).
+	Codec mAutoCodec;
+	//! The most bytes held at once.
+	int64_t mMemPeak;
 	
 };
 
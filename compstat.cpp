@@ -1,28 +1,58 @@
 #include "compstat.h"
+#include "estimate.h"
+#include "workload.h"
 
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
-#include <map>
 #include <cstdlib>
 #include <cmath>
 #include <zlib.h>
 
 
+//! Length of sequence with given distances (including the 'virtual' one).
+static int
+distBits(const std::vector<int> &dist)
+{
+	int n = dist.size() - 1;
+	for (int d : dist) n += d;
+	return n;
+}
+
 BinSeqStat::BinSeqStat(int n, int k):
+	BinSeqStat(n, k, nullptr)
+{
+}
+
+BinSeqStat::BinSeqStat(const std::vector<int> &dist):
+	BinSeqStat(distBits(dist), dist.size() - 1, &dist)
+{
+}
+
+BinSeqStat::BinSeqStat(int n, int k, const std::vector<int> *dist):
 	mN(n),
 	mK(k),
 	mSeq(n, 0),
 	mDist(k+1, 0),
+	mDistValid(false),
+	mCostValid(false),
 	mGenSeq(0),
-	mSumAcsbsCompressionBits(0),
-	mSumAcsbsCompressionWords(0),
-	mSumAcsbsCompressionCodeWordBits(0),
-	mSumRiceGolombCodeCompressionBits(0),
-	mSumRiceGolombCodeCompressionWords(0),
-	mSumRiceGolombCodeCompressionCodeWordBits(0),
-	mSumZLibDeflateCompressionBits(0)
+	mEstSeq(0),
+	mSumAcsbsEstError(0),
+	mSumAcsbsEstBound(0),
+	mSumRiceGolombEstError(0),
+	mSumRiceGolombEstBound(0),
+	mMemPeak(0),
+	mMemSeq(0),
+	mSumMemLive(0),
+	mSumMemUnused(0),
+	mSumAllocs(0)
 {
-	random();
+	if (dist) {
+		setDist(*dist);
+	} else {
+		random();
+	}
 
 	// Compute entropy.
 	double entropy = 0;
@@ -44,9 +74,8 @@ BinSeqStat::random()
 {
 	int k = mK;
 
-	// Clear sequence and distance vector.
+	// Clear sequence.
 	std::fill(mSeq.begin(), mSeq.end(), 0);
-	std::fill(mDist.begin(), mDist.end(), 0);
 	
 	// Set random bits in string.
 	while (0 < k) {
@@ -60,8 +89,162 @@ BinSeqStat::random()
 	packSeq();
 
 	// Find distatnces.
+	mDistValid = false;
+	mCostValid = false;
+	findDist();
+}
+
+void
+BinSeqStat::random(Workload &workload)
+{
+	workload.generate(mN, mK, mDist);
+	mDistValid = true;
+	mCostValid = false;
+	
+	// Set bits after distances.
+	std::fill(mSeq.begin(), mSeq.end(), 0);
+	int bit = -1;
+	for (int k = 0; k < mK; k++) {
+		bit += mDist[k] + 1;
+		mSeq[bit] = 1;
+	}
+
+	// Pack sequence.
+	packSeq();
+}
+
+void
+BinSeqStat::setDist(const std::vector<int> &dist)
+{
+	mDist = dist;
+	mDistValid = true;
+	mCostValid = false;
+	
+	// Set bits after distances.
+	std::fill(mSeq.begin(), mSeq.end(), 0);
+	int bit = -1;
+	for (int k = 0; k < mK; k++) {
+		bit += mDist[k] + 1;
+		mSeq[bit] = 1;
+	}
+
+	// Pack sequence.
+	packSeq();
+}
+
+void
+BinSeqStat::randomInsert(int s)
+{
+	if (mN - mK < s) s = mN - mK;
+	if (!mCostValid) findCost();
+	if (mOnesTree.empty()) buildOnesTree();
+	
+	for (; 0 < s; s--) {
+		int bit = rand() % mN;
+		if (mSeq[bit]) {
+			s++;
+			continue;
+		}
+		
+		// The new one splits distance between its neighbours (or ends of sequence).
+		int prev = prevOne(bit);
+		int next = nextOne(bit);
+		updateCost(next - prev - 1, -1);
+		updateCost(bit - prev - 1, 1);
+		updateCost(next - bit - 1, 1);
+		
+		mSeq[bit] = 1;
+		mPackSeq[bit / 8] |= 1 << (bit % 8);
+		for (int i = bit / 64 + 1; i < (int)mOnesTree.size(); i += i & -i) {
+			mOnesTree[i]++;
+		}
+		mEntropy += log2(mN - mK) - log2(mK + 1);
+		mK++;
+	}
+	mDistValid = false;
+}
+
+uint64_t
+BinSeqStat::packWord(int w) const
+{
+	// Packed sequence has no padding to whole words.
+	uint64_t word = 0;
+	int bytes = std::min<int>(8, mPackSeq.size() - 8*w);
+	for (int i = 0; i < bytes; i++) {
+		word |= (uint64_t)mPackSeq[8*w + i] << (8*i);
+	}
+	return word;
+}
+
+void
+BinSeqStat::buildOnesTree()
+{
+	// Tree counts from index 1 (node i covers words i - (i & -i) .. i - 1).
+	int words = (mN + 63) / 64;
+	mOnesTree.assign(words + 1, 0);
+	for (int i = 1; i <= words; i++) {
+		mOnesTree[i] += __builtin_popcountll(packWord(i - 1));
+		int j = i + (i & -i);
+		if (j <= words) mOnesTree[j] += mOnesTree[i];
+	}
+	noteMem();
+}
+
+int
+BinSeqStat::findOneWord(int r) const
+{
+	int w = 0;
+	int step = 1;
+	while (2*step < (int)mOnesTree.size()) step *= 2;
+	for (; step; step /= 2) {
+		if (w + step < (int)mOnesTree.size() && mOnesTree[w + step] <= r) {
+			w += step;
+			r -= mOnesTree[w];
+		}
+	}
+	return w;
+}
+
+int
+BinSeqStat::prevOne(int bit) const
+{
+	// Ones of the same word below the bit.
+	int w = bit / 64;
+	uint64_t word = packWord(w) & (((uint64_t)1 << (bit % 64)) - 1);
+	if (word) return 64*w + 63 - __builtin_clzll(word);
+	
+	// The last one before the word is the highest one of its word.
+	int ones = 0;
+	for (int i = w; 0 < i; i -= i & -i) ones += mOnesTree[i];
+	if (!ones) return -1;
+	w = findOneWord(ones - 1);
+	return 64*w + 63 - __builtin_clzll(packWord(w));
+}
+
+int
+BinSeqStat::nextOne(int bit) const
+{
+	// Ones of the same word above the bit.
+	int w = bit / 64;
+	uint64_t word = (bit % 64 == 63) ? 0 : packWord(w) & (~(uint64_t)0 << (bit % 64 + 1));
+	if (word) return 64*w + __builtin_ctzll(word);
+	
+	// The first one after the word is the lowest one of its word.
+	int ones = 0;
+	for (int i = w + 1; 0 < i; i -= i & -i) ones += mOnesTree[i];
+	if (ones == mK) return mN;
+	w = findOneWord(ones);
+	return 64*w + __builtin_ctzll(packWord(w));
+}
+
+void
+BinSeqStat::findDist()
+{
+	if (mDistValid) return;
+	
+	mDist.resize(mK + 1);
 	int d = 0;
-	k = 0;
+	int k = 0;
 	for (int i = 0; i < mN; i++) {
 		if (mSeq[i]) {
 			mDist[k++] = d;
@@ -71,11 +254,15 @@ BinSeqStat::random()
 		}
 	}
 	mDist[k] = d; // Last 'virtual' distance (distance to the end of string).
+	mDistValid = true;
+	noteMem();
 }
 
 void
-BinSeqStat::findAcsbsStat()
+BinSeqStat::findCost()
 {
+	findDist();
+	
 	// AC-SBS compression size.
 	for (int w = 1; w < WORD_BITS_MAX; w++) {
 		int m = (1 << w) - 1;
@@ -89,8 +276,44 @@ BinSeqStat::findAcsbsStat()
 		mAcsbsCompressionWordsByWordSize[w] = words;
 	}
 	
+	// Rice-Golomb compression size.
+	for (int w = 0; w < WORD_BITS_MAX; w++) {
+		int m = 1 << w;
+		int bits = 0;
+		int words = 0;
+		for (int k = 0; k < mK+1; k++) {
+			bits += (mDist[k] / m) + 1 + w;
+			words += (mDist[k] / m) + 2;
+		}
+		mRiceGolombCodeCompressionBitsByWordSize[w] = bits;
+		mRiceGolombCodeCompressionWordsByWordSize[w] = words;
+	}
+	mCostValid = true;
+}
+
+void
+BinSeqStat::updateCost(int d, int sign)
+{
+	for (int w = 1; w < WORD_BITS_MAX; w++) {
+		int words = d / ((1 << w) - 1) + 1;
+		mAcsbsCompressionBitsByWordSize[w] += sign*w*words;
+		mAcsbsCompressionWordsByWordSize[w] += sign*words;
+	}
+	for (int w = 0; w < WORD_BITS_MAX; w++) {
+		int q = d >> w;
+		mRiceGolombCodeCompressionBitsByWordSize[w] += sign*(q + 1 + w);
+		mRiceGolombCodeCompressionWordsByWordSize[w] += sign*(q + 2);
+	}
+}
+
+void
+BinSeqStat::findAcsbsStat()
+{
+	if (!mCostValid) findCost();
+	
 	mAcsbsOptimalWordBits = 1;
 	mAcsbsCompressionBits = mAcsbsCompressionBitsByWordSize[1];
+	mAcsbsCompressionWords = mAcsbsCompressionWordsByWordSize[1];
 	for (int w = 2; w < WORD_BITS_MAX; w++) {
 		int bits = mAcsbsCompressionBitsByWordSize[w];
 		int words = mAcsbsCompressionWordsByWordSize[w];
@@ -105,21 +328,11 @@ BinSeqStat::findAcsbsStat()
 void
 BinSeqStat::findGolombStat()
 {
-	// Rice-Golomb compression size.
-	for (int w = 0; w < WORD_BITS_MAX; w++) {
-		int m = 1 << w;
-		int bits = 0;
-		int words = 0;
-		for (int k = 0; k < mK+1; k++) {
-			bits += (mDist[k] / m) + 1 + w;
-			words += (mDist[k] / m) + 2;
-		}
-		mRiceGolombCodeCompressionBitsByWordSize[w] = bits;
-		mRiceGolombCodeCompressionWordsByWordSize[w] = words;
-	}
+	if (!mCostValid) findCost();
 	
 	mRiceGolombCodeOptimalWordBits = 0;
 	mRiceGolombCodeCompressionBits = mRiceGolombCodeCompressionBitsByWordSize[0];
+	mRiceGolombCodeCompressionWords = mRiceGolombCodeCompressionWordsByWordSize[0];
 	for (int w = 1; w < WORD_BITS_MAX; w++) {
 		int bits = mRiceGolombCodeCompressionBitsByWordSize[w];
 		int words = mRiceGolombCodeCompressionWordsByWordSize[w];
@@ -137,11 +350,37 @@ BinSeqStat::findZlibStat()
 	// Find zlib DEFLATE compression size.
 	unsigned long size = compressBound(mPackSeq.size());
 	mPackSeqZlib.resize(size);
+	noteMem();
 	compress(mPackSeqZlib.data(), &size, mPackSeq.data(), mPackSeq.size());
 	mPackSeqZlib.resize(size);
 	mZLibDeflateCompressionBits = 8*size;
 }
 
+void
+BinSeqStat::findEstimateStat(int sampleSize)
+{
+	// Estimate word bits in single pass over distances.
+	findDist();
+	WordBitsEstimator est(sampleSize, mGenSeq + 1);
+	est.add(mDist.data(), mK+1);
+	
+	int w = est.acsbsWordBits();
+	int bits = mAcsbsCompressionBitsByWordSize[w];
+	mAccAcsbsEstWordBits.add(w);
+	mAccAcsbsEstBits.add(bits);
+	mSumAcsbsEstError += fabs(est.acsbsBits(w) - bits) / bits;
+	mSumAcsbsEstBound += est.acsbsBound(w);
+	
+	w = est.riceWordBits();
+	bits = mRiceGolombCodeCompressionBitsByWordSize[w];
+	mAccRiceGolombEstWordBits.add(w);
+	mAccRiceGolombEstBits.add(bits);
+	mSumRiceGolombEstError += fabs(est.riceBits(w) - bits) / bits;
+	mSumRiceGolombEstBound += est.riceBound(w);
+	
+	mEstSeq++;
+}
+
 void
 BinSeqStat::findCompStat(bool excludeZlib)
 {
@@ -156,10 +395,94 @@ BinSeqStat::findCompStat(bool excludeZlib)
 	aggregateStat();
 }
 
+void
+BinSeqStat::merge(const BinSeqStat &bs)
+{
+	mGenSeq += bs.mGenSeq;
+	mAccAcsbsCompressionBits.merge(bs.mAccAcsbsCompressionBits);
+	mAccAcsbsCompressionWords.merge(bs.mAccAcsbsCompressionWords);
+	mAccAcsbsCompressionCodeWordBits.merge(bs.mAccAcsbsCompressionCodeWordBits);
+	mAccRiceGolombCodeCompressionBits.merge(bs.mAccRiceGolombCodeCompressionBits);
+	mAccRiceGolombCodeCompressionWords.merge(bs.mAccRiceGolombCodeCompressionWords);
+	mAccRiceGolombCodeCompressionCodeWordBits.merge(bs.mAccRiceGolombCodeCompressionCodeWordBits);
+	mAccZLibDeflateCompressionBits.merge(bs.mAccZLibDeflateCompressionBits);
+	
+	mEstSeq += bs.mEstSeq;
+	mAccAcsbsEstWordBits.merge(bs.mAccAcsbsEstWordBits);
+	mAccAcsbsEstBits.merge(bs.mAccAcsbsEstBits);
+	mSumAcsbsEstError += bs.mSumAcsbsEstError;
+	mSumAcsbsEstBound += bs.mSumAcsbsEstBound;
+	mAccRiceGolombEstWordBits.merge(bs.mAccRiceGolombEstWordBits);
+	mAccRiceGolombEstBits.merge(bs.mAccRiceGolombEstBits);
+	mSumRiceGolombEstError += bs.mSumRiceGolombEstError;
+	mSumRiceGolombEstBound += bs.mSumRiceGolombEstBound;
+	
+	mMemPeak = std::max(mMemPeak, bs.mMemPeak);
+	mMemSeq += bs.mMemSeq;
+	mSumMemLive += bs.mSumMemLive;
+	mSumMemUnused += bs.mSumMemUnused;
+	mSumAllocs += bs.mSumAllocs;
+}
+
+void
+BinSeqStat::clearStat()
+{
+	mGenSeq = 0;
+	mAccAcsbsCompressionBits.clear();
+	mAccAcsbsCompressionWords.clear();
+	mAccAcsbsCompressionCodeWordBits.clear();
+	mAccRiceGolombCodeCompressionBits.clear();
+	mAccRiceGolombCodeCompressionWords.clear();
+	mAccRiceGolombCodeCompressionCodeWordBits.clear();
+	mAccZLibDeflateCompressionBits.clear();
+	
+	mEstSeq = 0;
+	mAccAcsbsEstWordBits.clear();
+	mAccAcsbsEstBits.clear();
+	mSumAcsbsEstError = 0;
+	mSumAcsbsEstBound = 0;
+	mAccRiceGolombEstWordBits.clear();
+	mAccRiceGolombEstBits.clear();
+	mSumRiceGolombEstError = 0;
+	mSumRiceGolombEstBound = 0;
+	
+	mMemSeq = 0;
+	mSumMemLive = 0;
+	mSumMemUnused = 0;
+	mSumAllocs = 0;
+}
+
+void
+BinSeqStat::findMemStat(int64_t allocs)
+{
+	MemUsage mem = getMemUsage();
+	mSumMemLive += mem.live;
+	mSumMemUnused += mem.unused;
+	mSumAllocs += allocs;
+	mMemSeq++;
+}
+
+MemUsage
+BinSeqStat::getMemUsage() const
+{
+	MemUsage mem;
+	mem.live = sizeof(*this);
+	mem.live += mSeq.capacity() + mPackSeq.capacity() + mPackSeqZlib.capacity();
+	mem.live += sizeof(int)*(mDist.capacity() + mOnesTree.capacity());
+	mem.unused = mSeq.capacity() - mSeq.size();
+	mem.unused += mPackSeq.capacity() - mPackSeq.size();
+	mem.unused += mPackSeqZlib.capacity() - mPackSeqZlib.size();
+	mem.unused += sizeof(int)*(mDist.capacity() - mDist.size());
+	mem.unused += sizeof(int)*(mOnesTree.capacity() - mOnesTree.size());
+	mem.peak = std::max(mMemPeak, mem.live);
+	return mem;
+}
+
 void
 BinSeqStat::printSeq(bool withDistances)
 {
 	int k = 0;
+	findDist();
 	
 	// Print zeros and ones.
 	for (int i = 0; i < mN; i++) {
@@ -179,52 +502,59 @@ BinSeqStat::printSeq(bool withDistances)
 void
 BinSeqStat::printAcsbsStat()
 {
-	std::map<int,int> freqMap;
-	
-	int m = (1 << mAcsbsOptimalWordBits) - 1;
-	for (int k = 0; k < mK+1; k++) {
-		freqMap[mDist[k] / m] += 1;
-	}
-	
 	std::cout << "w = " << mAcsbsOptimalWordBits << std::endl;
-	for (std::map<int,int>::iterator it = freqMap.begin(); it != freqMap.end(); it++) {
-		std::cout << it->first << " => " << it->second << std::endl;
-	}
+	printFreq((1 << mAcsbsOptimalWordBits) - 1);
 }
 
 void
 BinSeqStat::printGolombStat()
 {
-	std::map<int,int> freqMap;
-	
-	int m = 1 << mRiceGolombCodeOptimalWordBits;
-	for (int k = 0; k < mK+1; k++) {
-		freqMap[mDist[k] / m] += 1;
-	}
-	
 	std::cout << "w = " << mRiceGolombCodeOptimalWordBits << std::endl;
-	for (std::map<int,int>::iterator it = freqMap.begin(); it != freqMap.end(); it++) {
-		std::cout << it->first << " => " << it->second << std::endl;
-	}
+	printFreq(1 << mRiceGolombCodeOptimalWordBits);
 }
 
 void
-BinSeqStat::printStat()
+BinSeqStat::printStat(bool withSpread)
 {
 	std::cout << std::setprecision(6) << (double)mK / mN << "\t";
-	std::cout << (mSumZLibDeflateCompressionBits / mGenSeq) << "\t";
-	std::cout << (mSumAcsbsCompressionBits / mGenSeq) << "\t";
-	std::cout << (mSumRiceGolombCodeCompressionBits / mGenSeq) << "\t";
-	std::cout << (mEntropy) << "\t";
-	std::cout << (mSumAcsbsCompressionWords / mGenSeq) << "\t";
-	std::cout << (mSumRiceGolombCodeCompressionWords / mGenSeq) << "\t";
-	std::cout << ((double)mSumAcsbsCompressionCodeWordBits / mGenSeq) << "\t";
-	std::cout << ((double)mSumRiceGolombCodeCompressionCodeWordBits / mGenSeq) << "\t";
+	std::cout << mAccZLibDeflateCompressionBits.mean() << "\t";
+	std::cout << mAccAcsbsCompressionBits.mean() << "\t";
+	std::cout << mAccRiceGolombCodeCompressionBits.mean() << "\t";
+	std::cout << (int)mEntropy << "\t";
+	std::cout << mAccAcsbsCompressionWords.mean() << "\t";
+	std::cout << mAccRiceGolombCodeCompressionWords.mean() << "\t";
+	std::cout << mAccAcsbsCompressionCodeWordBits.mean() << "\t";
+	std::cout << mAccRiceGolombCodeCompressionCodeWordBits.mean() << "\t";
+	if (mEstSeq) {
+		std::cout << mAccAcsbsEstBits.mean() << "\t";
+		std::cout << mAccAcsbsEstWordBits.mean() << "\t";
+		std::cout << (100*mSumAcsbsEstError / mEstSeq) << "\t";
+		std::cout << (100*mSumAcsbsEstBound / mEstSeq) << "\t";
+		std::cout << mAccRiceGolombEstBits.mean() << "\t";
+		std::cout << mAccRiceGolombEstWordBits.mean() << "\t";
+		std::cout << (100*mSumRiceGolombEstError / mEstSeq) << "\t";
+		std::cout << (100*mSumRiceGolombEstBound / mEstSeq) << "\t";
+	}
+	if (mMemSeq) {
+		std::cout << (mSumMemLive / mMemSeq) << "\t";
+		std::cout << (mSumMemUnused / mMemSeq) << "\t";
+		std::cout << getMemUsage().peak << "\t";
+		std::cout << ((double)mSumAllocs / mMemSeq) << "\t";
+	}
+	if (withSpread) {
+		const QuantileAccumulator *acc[] = { &mAccZLibDeflateCompressionBits,
+			&mAccAcsbsCompressionBits, &mAccRiceGolombCodeCompressionBits };
+		for (const QuantileAccumulator *a: acc) {
+			std::cout << a->stddev() << "\t";
+			std::cout << a->quantile(0.99) << "\t";
+			std::cout << a->max() << "\t";
+		}
+	}
 	std::cout << std::endl << std::flush;
 }
 
 void
-BinSeqStat::printStatHeader()
+BinSeqStat::printStatHeader(bool withEstimate, bool withMemory, bool withSpread)
 {
 	std::cout << "k/n" << "\t";
 	std::cout << "ZLIB" << "\t";
@@ -235,6 +565,30 @@ BinSeqStat::printStatHeader()
 	std::cout << "Rice-Golomb words" << "\t";
 	std::cout << "AC-SBS code word bits" << "\t";
 	std::cout << "Rice-Golomb code word bits" << "\t";
+	if (withEstimate) {
+		std::cout << "AC-SBS est." << "\t";
+		std::cout << "AC-SBS est. code word bits" << "\t";
+		std::cout << "AC-SBS est. error %" << "\t";
+		std::cout << "AC-SBS est. bound %" << "\t";
+		std::cout << "Rice-Golomb est." << "\t";
+		std::cout << "Rice-Golomb est. code word bits" << "\t";
+		std::cout << "Rice-Golomb est. error %" << "\t";
+		std::cout << "Rice-Golomb est. bound %" << "\t";
+	}
+	if (withMemory) {
+		std::cout << "Memory [B]" << "\t";
+		std::cout << "Memory unused [B]" << "\t";
+		std::cout << "Memory peak [B]" << "\t";
+		std::cout << "Allocations" << "\t";
+	}
+	if (withSpread) {
+		const char *names[] = { "ZLIB", "AC-SBS", "Rice-Golomb" };
+		for (const char *name: names) {
+			std::cout << name << " std. dev." << "\t";
+			std::cout << name << " p99" << "\t";
+			std::cout << name << " max" << "\t";
+		}
+	}
 	std::cout << std::endl << std::flush;
 }
 
@@ -242,6 +596,7 @@ void
 BinSeqStat::packSeq()
 {
 	mPackSeq = std::vector<unsigned char>((mN+7)/8, 0);
+	mOnesTree.clear();
 	
 	unsigned char *data = mPackSeq.data();
 
@@ -252,6 +607,7 @@ BinSeqStat::packSeq()
 			data++;
 		}
 	}
+	noteMem();
 }
 
 void
@@ -260,11 +616,32 @@ BinSeqStat::aggregateStat()
 	// Increase number of aggregated statistics.
 	mGenSeq++;
 
-	mSumAcsbsCompressionBits += mAcsbsCompressionBits;
-	mSumAcsbsCompressionWords += mAcsbsCompressionWords;
-	mSumAcsbsCompressionCodeWordBits += mAcsbsOptimalWordBits;
-	mSumRiceGolombCodeCompressionBits += mRiceGolombCodeCompressionBits;
-	mSumRiceGolombCodeCompressionWords += mRiceGolombCodeCompressionWords;
-	mSumRiceGolombCodeCompressionCodeWordBits += mRiceGolombCodeOptimalWordBits;
-	mSumZLibDeflateCompressionBits += mZLibDeflateCompressionBits;	
+	mAccAcsbsCompressionBits.add(mAcsbsCompressionBits);
+	mAccAcsbsCompressionWords.add(mAcsbsCompressionWords);
+	mAccAcsbsCompressionCodeWordBits.add(mAcsbsOptimalWordBits);
+	mAccRiceGolombCodeCompressionBits.add(mRiceGolombCodeCompressionBits);
+	mAccRiceGolombCodeCompressionWords.add(mRiceGolombCodeCompressionWords);
+	mAccRiceGolombCodeCompressionCodeWordBits.add(mRiceGolombCodeOptimalWordBits);
+	mAccZLibDeflateCompressionBits.add(mZLibDeflateCompressionBits);
+}
+
+void
+BinSeqStat::printFreq(int m)
+{
+	// Quotients are at most n/m and counted in flat array.
+	findDist();
+	mFreq.assign(mN / m + 1, 0);
+	for (int k = 0; k < mK+1; k++) {
+		mFreq[mDist[k] / m] += 1;
+	}
+	
+	for (int q = 0; q < (int)mFreq.size(); q++) {
+		if (mFreq[q]) std::cout << q << " => " << mFreq[q] << std::endl;
+	}
+}
+
+void
+BinSeqStat::noteMem()
+{
+	mMemPeak = std::max(mMemPeak, getMemUsage().live);
 }
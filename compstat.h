@@ -1,8 +1,13 @@
 #ifndef __COMPSTAT_H__
 #define __COMPSTAT_H__
 
+#include "accumulator.h"
+#include "memstat.h"
+
 #include <vector>
 
+class Workload;
+
 #ifndef WORD_BITS_MAX
 //! Maximum size of compression Word.
 #define WORD_BITS_MAX 30
@@ -14,20 +19,43 @@ class BinSeqStat
 public:
 	//! Random binery sequence of n elaments with exactly k ones.
 	BinSeqStat(int n = 0, int k = 0);
+	//! Binary sequence at given distances (including the 'virtual' one), no random one
+	//! is generated.
+	explicit BinSeqStat(const std::vector<int> &dist);
 
 	//! Entropy of sequence.
 	int entropy() const;
 
 	//! Random binery sequence of n elaments with exactly k ones.
 	void random();
+	//! Binary sequence of n elements with k ones from workload generator.
+	void random(Workload &workload);
+	//! Binary sequence of n elements with k ones at given distances (including the 'virtual' one).
+	void setDist(const std::vector<int> &dist);
+	//! Add s ones at random to current sequence (neighbours of new one are found by
+	//! counts of ones per word in O(log n), sizes by code word bits are updated
+	//! incrementally, distances are found again only when needed).
+	void randomInsert(int s);
 	//! Determine AC-SBS statistics.
 	void findAcsbsStat();
 	//! Determine Rice-Golomb statistics.
 	void findGolombStat();
 	//! Determine Lempel-Ziv (zlib) statistics.
 	void findZlibStat();
+	//! Determine AC-SBS and Rice-Golomb statistics of word bits estimated from sample
+	//! (after findAcsbsStat() and findGolombStat()).
+	void findEstimateStat(int sampleSize);
 	//! Determine all avaliable statistics.
 	void findCompStat(bool excludeZlib = false);
+	//! Add aggregated statistics of another set of sequences (e.g. of another thread).
+	void merge(const BinSeqStat &bs);
+	//! Forget aggregated statistics (current sequence is kept).
+	void clearStat();
+	//! Add memory held by this sequence and heap allocations of its statistics to
+	//! aggregation.
+	void findMemStat(int64_t allocs);
+	//! Memory held by sequence: bits, packed and ZLIB compressed sequence and distances.
+	MemUsage getMemUsage() const;
 	
 	//! Print sequence.
 	void printSeq(bool withDistances = true);
@@ -35,16 +63,41 @@ public:
 	void printAcsbsStat();
 	//! Print Rice-Golomb statistics.
 	void printGolombStat();
-	//! Print all statistics.
-	void printStat();
-	//! Print header for all statistics.
-	static void printStatHeader();
+	//! Print all statistics (with standard deviation, 99th percentile and maximum of
+	//! compressed sizes).
+	void printStat(bool withSpread = false);
+	//! Print header for all statistics (with columns of estimated word bits, memory and
+	//! spread of compressed sizes).
+	static void printStatHeader(bool withEstimate = false, bool withMemory = false,
+		bool withSpread = false);
 
 protected:
+	//! Sequence of n elements with k ones at given distances (random if none).
+	BinSeqStat(int n, int k, const std::vector<int> *dist);
 	//! Pack sequence vector (every bit in separate byte) to binary string.
 	void packSeq();
 	//! Add statistics of this sequence to aggregation.
 	void aggregateStat();
+	//! Find distances of sequence (if out of date).
+	void findDist();
+	//! Determine AC-SBS and Rice-Golomb sizes by code word bits from distances.
+	void findCost();
+	//! Add (sign 1) or remove (sign -1) distance from sizes by code word bits.
+	void updateCost(int d, int sign);
+	//! 64 bits of packed sequence starting at bit 64*w.
+	uint64_t packWord(int w) const;
+	//! Count ones per word of packed sequence (Fenwick tree).
+	void buildOnesTree();
+	//! Position of the last one before given bit (-1 if none).
+	int prevOne(int bit) const;
+	//! Position of the first one after given bit (n if none).
+	int nextOne(int bit) const;
+	//! Word of packed sequence with the r-th one counted from 0.
+	int findOneWord(int r) const;
+	//! Update peak of memory after change of buffers.
+	void noteMem();
+	//! Print frequencies of distances divided by m (flat histogram).
+	void printFreq(int m);
 
 private:
 	//! \defgroup CompstatSP Sequence properties.
@@ -55,15 +108,23 @@ private:
 	//! Number of ones in sequence.
 	int mK;
 	//! Sequence entropy.
-	int mEntropy;
+	double mEntropy;
 	//! Vector of bits (single bit in single char).
 	std::vector<unsigned char> mSeq;
 	//! Packed sequence of bits (8 bits in single char).
 	std::vector<unsigned char> mPackSeq;
+	//! Fenwick tree of ones per word of packed sequence (empty if out of date).
+	std::vector<int> mOnesTree;
 	//! Sequence packed with ZLIB.
 	std::vector<unsigned char> mPackSeqZlib;
 	//! Sequence of distances between ones.
 	std::vector<int> mDist;
+	//! Distances match sequence.
+	bool mDistValid;
+	//! Sizes by code word bits match sequence.
+	bool mCostValid;
+	//! Frequencies of divided distances (reused by printFreq()).
+	std::vector<int> mFreq;
 	//! \}
 	
 	//! \defgroup CompstatSCS Sequence compression statistics.
@@ -98,20 +159,58 @@ private:
 	
 	//! Number of generated random sequences.
 	int mGenSeq;
-	//! Sum of number of bits in all generated AC-SBS compressed streams.
-	long mSumAcsbsCompressionBits;
-	//! Sum of number of coding words in all generated AC-SBS compressed streams.
-	long mSumAcsbsCompressionWords;
-	//! Sum of number of optimal coding words bits in all generated AC-SBS compressed streams.
-	long mSumAcsbsCompressionCodeWordBits;
-	//! Sum of number of bits in all generated Rice-Golomb compressed streams.
-	long mSumRiceGolombCodeCompressionBits;
-	//! Sum of number of coding words in all generated Rice-Golomb compressed streams.
-	long mSumRiceGolombCodeCompressionWords;
-	//! Sum of number of optimal coding words bits in all generated Rice-Golomb compressed streams.
-	long mSumRiceGolombCodeCompressionCodeWordBits;
-	//! Sum of number of bits in all generated Lempel-Ziv compressed streams.
-	long mSumZLibDeflateCompressionBits;
+	//! Number of bits of all generated AC-SBS compressed streams.
+	QuantileAccumulator mAccAcsbsCompressionBits;
+	//! Number of coding words of all generated AC-SBS compressed streams.
+	Accumulator mAccAcsbsCompressionWords;
+	//! Optimal coding words bits of all generated AC-SBS compressed streams.
+	Accumulator mAccAcsbsCompressionCodeWordBits;
+	//! Number of bits of all generated Rice-Golomb compressed streams.
+	QuantileAccumulator mAccRiceGolombCodeCompressionBits;
+	//! Number of coding words of all generated Rice-Golomb compressed streams.
+	Accumulator mAccRiceGolombCodeCompressionWords;
+	//! Optimal coding words bits of all generated Rice-Golomb compressed streams.
+	Accumulator mAccRiceGolombCodeCompressionCodeWordBits;
+	//! Number of bits of all generated Lempel-Ziv compressed streams.
+	QuantileAccumulator mAccZLibDeflateCompressionBits;
+	//! \}
+	
+	//! \defgroup CompstatEst Estimated word bits statistics.
+	//! \{
+	
+	//! Number of sequences with estimated word bits.
+	int mEstSeq;
+	//! Estimated AC-SBS word bits.
+	Accumulator mAccAcsbsEstWordBits;
+	//! AC-SBS compressed stream bits with estimated word bits.
+	Accumulator mAccAcsbsEstBits;
+	//! Sum of relative errors of predicted AC-SBS sizes.
+	double mSumAcsbsEstError;
+	//! Sum of relative error bounds of predicted AC-SBS sizes.
+	double mSumAcsbsEstBound;
+	//! Estimated Rice-Golomb word bits.
+	Accumulator mAccRiceGolombEstWordBits;
+	//! Rice-Golomb compressed stream bits with estimated word bits.
+	Accumulator mAccRiceGolombEstBits;
+	//! Sum of relative errors of predicted Rice-Golomb sizes.
+	double mSumRiceGolombEstError;
+	//! Sum of relative error bounds of predicted Rice-Golomb sizes.
+	double mSumRiceGolombEstBound;
+	//! \}
+	
+	//! \defgroup CompstatMem Memory statistics.
+	//! \{
+	
+	//! The most bytes held at once.
+	int64_t mMemPeak;
+	//! Number of sequences with memory statistics.
+	int mMemSeq;
+	//! Sum of bytes held by sequences.
+	int64_t mSumMemLive;
+	//! Sum of reserved but unused bytes of sequences.
+	int64_t mSumMemUnused;
+	//! Sum of heap allocations of sequence statistics.
+	int64_t mSumAllocs;
 	//! \}
 
 };
@@ -0,0 +1,214 @@
+#include "corpus.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//! Check suffix of file name.
+static bool
+hasSuffix(const std::string &path, const char *suffix)
+{
+	size_t n = strlen(suffix);
+	return n <= path.size() && path.compare(path.size() - n, n, suffix) == 0;
+}
+
+//! Little-endian 32-bit number at (possibly unaligned) address.
+static inline uint32_t
+readU32(const unsigned char *data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+Corpus::Corpus()
+{
+}
+
+Corpus::~Corpus()
+{
+	for (File &file: mFiles) {
+		if (file.size) munmap((void *)file.data, file.size);
+	}
+}
+
+bool
+Corpus::load(const std::string &path, int bits)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) {
+		std::cerr << "Cannot open " << path << "." << std::endl;
+		return false;
+	}
+	if (!S_ISDIR(st.st_mode)) return loadFile(path, bits);
+	
+	// Corpus files of directory in order of names.
+	DIR *dir = opendir(path.c_str());
+	if (!dir) {
+		std::cerr << "Cannot open " << path << "." << std::endl;
+		return false;
+	}
+	std::vector<std::string> names;
+	while (struct dirent *entry = readdir(dir)) {
+		std::string name(entry->d_name);
+		if (hasSuffix(name, ".bits") || hasSuffix(name, ".pos")) names.push_back(name);
+	}
+	closedir(dir);
+	std::sort(names.begin(), names.end());
+	
+	for (const std::string &name: names) {
+		if (!loadFile(path + "/" + name, bits)) return false;
+	}
+	return true;
+}
+
+bool
+Corpus::loadFile(const std::string &path, int bits)
+{
+	bool positions = hasSuffix(path, ".pos");
+	if (!positions && !hasSuffix(path, ".bits")) {
+		std::cerr << "Unknown corpus file " << path << " (.bits or .pos expected)." << std::endl;
+		return false;
+	}
+	
+	int fd = open(path.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		std::cerr << "Cannot open " << path << "." << std::endl;
+		if (0 <= fd) close(fd);
+		return false;
+	}
+	File file = { path, 0, (size_t)st.st_size };
+	if (file.size) {
+		void *data = mmap(0, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			std::cerr << "Cannot map " << path << "." << std::endl;
+			close(fd);
+			return false;
+		}
+		file.data = (const unsigned char *)data;
+	}
+	close(fd);
+	mFiles.push_back(file);
+	
+	Item item = { (int)mFiles.size() - 1, 0, positions, 0, 0, 0 };
+	size_t offset = 0;
+	if (positions) {
+		// Records of bits, count and positions.
+		while (offset + 8 <= file.size) {
+			item.bits = readU32(file.data + offset);
+			item.count = readU32(file.data + offset + 4);
+			item.data = file.data + offset + 8;
+			if (item.bits < 0 || item.count < 0 ||
+				(file.size - offset - 8) / 4 < (size_t)item.count) break;
+			// Positions have to be increasing and inside bitmap.
+			int64_t last = -1;
+			int j = 0;
+			for (; j < item.count; j++) {
+				int64_t bit = readU32(item.data + 4*j);
+				if (bit <= last || item.bits <= bit) break;
+				last = bit;
+			}
+			if (j < item.count) break;
+			offset += 8 + 4*(size_t)item.count;
+			mItems.push_back(item);
+			item.index++;
+		}
+	} else {
+		// Whole file or consecutive bitmaps starting at byte boundary.
+		size_t step = bits ? (bits + 7) / 8 : file.size;
+		while (step && offset + step <= file.size && 8*step <= 0x7FFFFFFF) {
+			item.bits = bits ? bits : 8*step;
+			item.data = file.data + offset;
+			offset += step;
+			mItems.push_back(item);
+			item.index++;
+		}
+	}
+	
+	if (offset != file.size) {
+		std::cerr << "Malformed corpus file " << path << "." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int
+Corpus::size() const
+{
+	return mItems.size();
+}
+
+std::string
+Corpus::name(int i) const
+{
+	return mFiles[mItems[i].file].path + ":" + std::to_string(mItems[i].index);
+}
+
+int
+Corpus::bits(int i) const
+{
+	return mItems[i].bits;
+}
+
+int
+Corpus::ones(int i) const
+{
+	const Item &item = mItems[i];
+	if (item.positions) return item.count;
+	
+	int ones = 0;
+	for (int b = 0; b < item.bits / 8; b++) ones += __builtin_popcount(item.data[b]);
+	if (item.bits % 8) ones += __builtin_popcount(item.data[item.bits / 8] & ((1 << (item.bits % 8)) - 1));
+	return ones;
+}
+
+void
+Corpus::get(int i, BitString &bs) const
+{
+	const Item &item = mItems[i];
+	if (!item.positions) {
+		bs.setPacked(item.bits, item.data);
+		return;
+	}
+	
+	std::vector<int> positions(item.count);
+	for (int j = 0; j < item.count; j++) {
+		positions[j] = readU32(item.data + 4*j);
+	}
+	bs.setPositions(item.bits, positions);
+}
+
+void
+Corpus::getDist(int i, std::vector<int> &dist) const
+{
+	const Item &item = mItems[i];
+	dist.clear();
+	int last = -1;
+	
+	if (item.positions) {
+		for (int j = 0; j < item.count; j++) {
+			int bit = readU32(item.data + 4*j);
+			dist.push_back(bit - last - 1);
+			last = bit;
+		}
+	} else {
+		// Byte by byte (mapped data need not be aligned).
+		for (int b = 0; b < (item.bits + 7) / 8; b++) {
+			unsigned int byte = item.data[b];
+			if (item.bits < 8*(b + 1)) byte &= (1 << (item.bits % 8)) - 1;
+			while (byte) {
+				int bit = 8*b + __builtin_ctz(byte);
+				dist.push_back(bit - last - 1);
+				last = bit;
+				byte &= byte - 1;
+			}
+		}
+	}
+	// The last 'virtual' one.
+	dist.push_back(item.bits - last - 1);
+}
@@ -0,0 +1,70 @@
+#ifndef __CORPUS_H__
+#define __CORPUS_H__
+
+#include "compress.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//! Bitmaps of corpus files mapped to memory.
+//!
+//! Supported files:
+//! - *.bits: raw packed bits (least significant bit of byte first), the whole file is one
+//!   bitmap or consecutive bitmaps of given bits (each starts at byte boundary);
+//! - *.pos: lists of positions as little-endian uint32: bits, count, count sorted positions
+//!   (repeated up to the end of file).
+class Corpus
+{
+public:
+	Corpus();
+	Corpus(const Corpus &) = delete;
+	~Corpus();
+
+	//! Map file or all corpus files of directory (bits splits raw files, 0 = whole file),
+	//! false on error (message is printed).
+	bool load(const std::string &path, int bits = 0);
+
+	//! Number of bitmaps.
+	int size() const;
+	//! Name of bitmap (file and index in file).
+	std::string name(int i) const;
+	//! Number of bits of bitmap.
+	int bits(int i) const;
+	//! Number of ones of bitmap (needs counting for raw bits).
+	int ones(int i) const;
+	//! Replace bitstring by bitmap (raw bits are copied by words, positions make sparse string).
+	void get(int i, BitString &bs) const;
+	//! Distances between ones of bitmap (including the 'virtual' one).
+	void getDist(int i, std::vector<int> &dist) const;
+
+protected:
+	//! Map single file and add its bitmaps.
+	bool loadFile(const std::string &path, int bits);
+
+private:
+	//! Mapped file.
+	struct File
+	{
+		std::string path;
+		const unsigned char *data;
+		size_t size;
+	};
+	//! Bitmap in mapped file.
+	struct Item
+	{
+		int file;
+		int index;
+		bool positions;
+		const unsigned char *data;
+		int bits;
+		int count;
+	};
+
+	//! Mapped files.
+	std::vector<File> mFiles;
+	//! Bitmaps in order of files.
+	std::vector<Item> mItems;
+};
+
+#endif // __CORPUS_H__
@@ -0,0 +1,161 @@
+#include "estimate.h"
+
+#include <cmath>
+
+//! Size of AC-SBS code words of distance.
+static inline double
+acsbsCost(int dist, int w)
+{
+	int m = (1 << w) - 1;
+	return w*(dist / m + 1);
+}
+
+//! Size of Rice-Golomb code word of distance.
+static inline double
+riceCost(int dist, int w)
+{
+	return (dist >> w) + 1 + w;
+}
+
+WordBitsEstimator::WordBitsEstimator(int sampleSize, uint64_t seed):
+	mSampleSize(sampleSize < 1 ? 1 : sampleSize),
+	mSeed(seed ? seed : 1),
+	mState(mSeed),
+	mCount(0)
+{
+	mSample.reserve(mSampleSize);
+}
+
+void
+WordBitsEstimator::clear()
+{
+	mState = mSeed;
+	mCount = 0;
+	mSample.clear();
+}
+
+void
+WordBitsEstimator::add(int dist)
+{
+	mCount++;
+	if ((int)mSample.size() < mSampleSize) {
+		mSample.push_back(dist);
+		return;
+	}
+	// Replace random item so that every distance is in sample with equal probability.
+	uint64_t i = next() % mCount;
+	if (i < (uint64_t)mSampleSize) mSample[i] = dist;
+}
+
+void
+WordBitsEstimator::add(const int *dist, int count)
+{
+	for (int i = 0; i < count; i++) add(dist[i]);
+}
+
+int64_t
+WordBitsEstimator::count() const
+{
+	return mCount;
+}
+
+int
+WordBitsEstimator::sampleCount() const
+{
+	return mSample.size();
+}
+
+int
+WordBitsEstimator::acsbsWordBits() const
+{
+	int wordBits = 1;
+	double bits = estimate(false, 1, 0);
+	for (int w = 2; w < WORD_BITS_MAX; w++) {
+		double b = estimate(false, w, 0);
+		if (b < bits) {
+			wordBits = w;
+			bits = b;
+		}
+	}
+	return wordBits;
+}
+
+int
+WordBitsEstimator::riceWordBits() const
+{
+	int wordBits = 0;
+	double bits = estimate(true, 0, 0);
+	for (int w = 1; w < WORD_BITS_MAX; w++) {
+		double b = estimate(true, w, 0);
+		if (b < bits) {
+			wordBits = w;
+			bits = b;
+		}
+	}
+	return wordBits;
+}
+
+double
+WordBitsEstimator::acsbsBits(int w) const
+{
+	return estimate(false, w, 0);
+}
+
+double
+WordBitsEstimator::riceBits(int w) const
+{
+	return estimate(true, w, 0);
+}
+
+double
+WordBitsEstimator::acsbsBound(int w) const
+{
+	double bound;
+	estimate(false, w, &bound);
+	return bound;
+}
+
+double
+WordBitsEstimator::riceBound(int w) const
+{
+	double bound;
+	estimate(true, w, &bound);
+	return bound;
+}
+
+uint64_t
+WordBitsEstimator::next()
+{
+	mState ^= mState >> 12;
+	mState ^= mState << 25;
+	mState ^= mState >> 27;
+	return mState * 0x2545F4914F6CDD1D;
+}
+
+double
+WordBitsEstimator::estimate(bool rice, int w, double *bound) const
+{
+	int s = mSample.size();
+	if (s == 0) {
+		if (bound) *bound = 0;
+		return 0;
+	}
+	
+	double sum = 0;
+	double sum2 = 0;
+	for (int i = 0; i < s; i++) {
+		double c = rice ? riceCost(mSample[i], w) : acsbsCost(mSample[i], w);
+		sum += c;
+		sum2 += c*c;
+	}
+	double mean = sum / s;
+	
+	if (bound) {
+		// Standard error of mean with finite population correction (exact if all seen).
+		double var = (1 < s) ? (sum2 - sum*mean) / (s - 1) : 0;
+		double fpc = (1 < mCount) ? (double)(mCount - s) / (mCount - 1) : 0;
+		*bound = 2*sqrt(var > 0 ? var*fpc / s : 0) / mean;
+	}
+	
+	return mean*mCount;
+}
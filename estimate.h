@@ -0,0 +1,63 @@
+#ifndef __ESTIMATE_H__
+#define __ESTIMATE_H__
+
+#include <cstdint>
+#include <vector>
+
+#ifndef WORD_BITS_MAX
+//! Maximum size of compression Word.
+#define WORD_BITS_MAX 30
+#endif
+
+//! Streaming estimation of optimal code word bits from a reservoir sample of distances.
+class WordBitsEstimator
+{
+public:
+	//! Estimator keeping at most sampleSize distances (seed makes sampling repeatable).
+	WordBitsEstimator(int sampleSize = 1024, uint64_t seed = 1);
+
+	//! Forget all distances.
+	void clear();
+	//! Add next distance of stream.
+	void add(int dist);
+	//! Add next distances of stream.
+	void add(const int *dist, int count);
+
+	//! Number of distances seen.
+	int64_t count() const;
+	//! Number of distances in sample.
+	int sampleCount() const;
+
+	//! Estimated optimal AC-SBS word bits.
+	int acsbsWordBits() const;
+	//! Estimated optimal Rice-Golomb word bits.
+	int riceWordBits() const;
+	//! Estimated AC-SBS encoding size of whole stream for given word bits.
+	double acsbsBits(int w) const;
+	//! Estimated Rice-Golomb encoding size of whole stream for given word bits.
+	double riceBits(int w) const;
+	//! Bound on relative error of acsbsBits(w) (two standard errors, about 95 %).
+	double acsbsBound(int w) const;
+	//! Bound on relative error of riceBits(w) (two standard errors, about 95 %).
+	double riceBound(int w) const;
+
+protected:
+	//! Next pseudo-random number (xorshift64*).
+	uint64_t next();
+	//! Estimated size and relative error bound from per-distance costs of sample.
+	double estimate(bool rice, int w, double *bound) const;
+
+private:
+	//! Maximum number of distances in sample.
+	int mSampleSize;
+	//! Seed of pseudo-random generator.
+	uint64_t mSeed;
+	//! State of pseudo-random generator.
+	uint64_t mState;
+	//! Number of distances seen.
+	int64_t mCount;
+	//! Reservoir sample of distances.
+	std::vector<int> mSample;
+};
+
+#endif // __ESTIMATE_H__
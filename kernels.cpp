@@ -0,0 +1,135 @@
+#include "kernels.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+// Variants of instruction sets are the same source (kernels.inc) compiled for each
+// target, their speed comes from vectorization and instructions chosen by compiler.
+
+#define KERNEL_NS scalar
+#define KERNEL_NAME "scalar"
+#include "kernels.inc"
+#undef KERNEL_NS
+#undef KERNEL_NAME
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#pragma GCC push_options
+#pragma GCC target("sse4.2,popcnt")
+#define KERNEL_NS sse42
+#define KERNEL_NAME "sse4.2"
+#include "kernels.inc"
+#undef KERNEL_NS
+#undef KERNEL_NAME
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,bmi,bmi2,lzcnt,popcnt")
+#define KERNEL_NS avx2
+#define KERNEL_NAME "avx2"
+#include "kernels.inc"
+#undef KERNEL_NS
+#undef KERNEL_NAME
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw,avx512dq,avx512vl,avx2,bmi,bmi2,lzcnt,popcnt")
+#define KERNEL_NS avx512
+#define KERNEL_NAME "avx512"
+#include "kernels.inc"
+#undef KERNEL_NS
+#undef KERNEL_NAME
+#pragma GCC pop_options
+
+//! Kernel tables by instruction set.
+static const CodecKernels *tables[ISA_COUNT] = {
+	&scalar::table, &sse42::table, &avx2::table, &avx512::table
+};
+
+#else
+
+//! Kernel tables by instruction set (only scalar outside x86).
+static const CodecKernels *tables[ISA_COUNT] = {
+	&scalar::table, 0, 0, 0
+};
+
+#endif
+
+//! Instruction set set by setKernelIsa() (ISA_COUNT for the detected one).
+static std::atomic<int> currentIsa(ISA_COUNT);
+
+bool
+kernelIsaSupported(KernelIsa isa)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	switch (isa) {
+	case ISA_SCALAR:
+		return true;
+	case ISA_SSE42:
+		return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+	case ISA_AVX2:
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2");
+	case ISA_AVX512:
+		return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+			__builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl") &&
+			__builtin_cpu_supports("bmi2");
+	default:
+		return false;
+	}
+#else
+	return isa == ISA_SCALAR;
+#endif
+}
+
+bool
+setKernelIsa(KernelIsa isa)
+{
+	if (isa < 0 || ISA_COUNT <= isa || !kernelIsaSupported(isa)) return false;
+	currentIsa.store(isa, std::memory_order_relaxed);
+	return true;
+}
+
+bool
+setKernelIsa(const char *name)
+{
+	for (int isa = 0; isa < ISA_COUNT; isa++) {
+		if (tables[isa] && strcmp(tables[isa]->name, name) == 0) {
+			return setKernelIsa((KernelIsa)isa);
+		}
+	}
+	return false;
+}
+
+//! The best instruction set supported by CPU or the one given by environment.
+static KernelIsa
+detectKernelIsa()
+{
+	// Environment variable overrides detection (e.g. for testing).
+	const char *name = getenv("ACSBS_ISA");
+	if (name) {
+		for (int isa = 0; isa < ISA_COUNT; isa++) {
+			if (tables[isa] && strcmp(tables[isa]->name, name) == 0 &&
+				kernelIsaSupported((KernelIsa)isa)) return (KernelIsa)isa;
+		}
+	}
+	int isa = ISA_COUNT - 1;
+	while (!kernelIsaSupported((KernelIsa)isa)) isa--;
+	return (KernelIsa)isa;
+}
+
+KernelIsa
+kernelIsa()
+{
+	// Detection runs once even if threads start at once (static initialization).
+	static const KernelIsa detected = detectKernelIsa();
+	int isa = currentIsa.load(std::memory_order_relaxed);
+	return (isa == ISA_COUNT) ? detected : (KernelIsa)isa;
+}
+
+const CodecKernels &
+kernels()
+{
+	return *tables[kernelIsa()];
+}
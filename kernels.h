@@ -0,0 +1,63 @@
+#ifndef __KERNELS_H__
+#define __KERNELS_H__
+
+#include "compress.h"
+
+//! Instruction sets with own variant of codec kernels.
+enum KernelIsa
+{
+	ISA_SCALAR = 0,
+	ISA_SSE42 = 1,
+	ISA_AVX2 = 2,
+	ISA_AVX512 = 3,
+	ISA_COUNT = 4
+};
+
+//! Words readable past the last word of encoding (decoders load unaligned 64 bits
+//! without checks except in the final block, so they never read further).
+#define DECODE_PAD_WORDS 1
+
+//! Table of codec kernels compiled for single instruction set.
+struct CodecKernels
+{
+	//! Name of instruction set.
+	const char *name;
+	//! Number of ones in packed words.
+	int (*popcount)(const Word64 *words, int count);
+	//! Distances between ones of packed bits without the 'virtual' one (*last is position
+	//! of the preceding one, possibly negative, and receives position of the last one),
+	//! returns number of distances.
+	int (*findDist)(const Word64 *words, int bits, int *last, int *dist);
+	//! AC-SBS encoding sizes for all code word bits (cost[0] is unused).
+	void (*acsbsCost)(const int *dist, int count, int *cost);
+	//! Rice-Golomb encoding sizes for all code word bits.
+	void (*riceCost)(const int *dist, int count, int *cost);
+	//! Write AC-SBS code words of distances to zeroed bits from encBits on, returns end bit.
+	int (*acsbsEncode)(const int *dist, int count, int acsbsBits, Word64 *enc, int encBits);
+	//! Write Rice-Golomb code words of distances to zeroed bits from encBits on,
+	//! returns end bit.
+	int (*riceEncode)(const int *dist, int count, int riceBits, Word64 *enc, int encBits);
+	//! Decode AC-SBS code words from bits [*begin, end) until maxDist distances are found,
+	//! returns number of distances (*begin is moved past decoded code words) or -1 for
+	//! malformed code words (partial, unfinished or too long distance).
+	int (*acsbsDecode)(const Word64 *enc, int *begin, int end, int acsbsBits, int *dist,
+		int maxDist);
+	//! Decode Rice-Golomb code words from bits [*begin, end) until maxDist distances are
+	//! found, returns number of distances (*begin is moved past decoded code words) or -1
+	//! for malformed code words (crossing end or too long distance).
+	int (*riceDecode)(const Word64 *enc, int *begin, int end, int riceBits, int *dist,
+		int maxDist);
+};
+
+//! Kernels in use (best supported by CPU, ACSBS_ISA environment variable overrides).
+const CodecKernels &kernels();
+//! Instruction set of kernels in use.
+KernelIsa kernelIsa();
+//! Check if CPU can run kernels for given instruction set.
+bool kernelIsaSupported(KernelIsa isa);
+//! Use kernels for given instruction set (false if not supported by CPU).
+bool setKernelIsa(KernelIsa isa);
+//! Use kernels for instruction set given by name (scalar, sse4.2, avx2, avx512).
+bool setKernelIsa(const char *name);
+
+#endif // __KERNELS_H__
@@ -0,0 +1,152 @@
+#include "memstat.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+//! Header in front of every block (keeps alignment of malloc).
+struct BlockHeader
+{
+	//! Bytes requested.
+	size_t bytes;
+	//! Deallocator of block.
+	FreeHook free;
+};
+
+static_assert(sizeof(BlockHeader) % alignof(std::max_align_t) == 0,
+	"BlockHeader must keep alignment of blocks");
+
+//! Allocator and deallocator of new blocks.
+static std::atomic<AllocHook> allocHook(malloc);
+static std::atomic<FreeHook> freeHook(free);
+
+//! Counters (relaxed, they are read after operations).
+static std::atomic<int64_t> allocCount(0);
+static std::atomic<int64_t> freeCount(0);
+static std::atomic<int64_t> allocBytes(0);
+static std::atomic<int64_t> liveBytes(0);
+static std::atomic<int64_t> peakBytes(0);
+
+void
+setAllocHooks(AllocHook alloc, FreeHook free)
+{
+	if (!alloc || !free) {
+		alloc = ::malloc;
+		free = ::free;
+	}
+	// Blocks allocated in between are freed by the old deallocator.
+	freeHook.store(free);
+	allocHook.store(alloc);
+}
+
+AllocStat
+getAllocStat()
+{
+	AllocStat stat;
+	stat.allocs = allocCount.load(std::memory_order_relaxed);
+	stat.frees = freeCount.load(std::memory_order_relaxed);
+	stat.bytes = allocBytes.load(std::memory_order_relaxed);
+	stat.live = liveBytes.load(std::memory_order_relaxed);
+	stat.peak = peakBytes.load(std::memory_order_relaxed);
+	return stat;
+}
+
+void
+resetAllocPeak()
+{
+	peakBytes.store(liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+//! Allocate counted block (null if allocator fails).
+static void *
+countedAlloc(size_t bytes)
+{
+	FreeHook free = freeHook.load();
+	BlockHeader *h = (BlockHeader *)allocHook.load()(sizeof(BlockHeader) + bytes);
+	if (!h) return 0;
+	h->bytes = bytes;
+	h->free = free;
+
+	allocCount.fetch_add(1, std::memory_order_relaxed);
+	allocBytes.fetch_add(bytes, std::memory_order_relaxed);
+	int64_t live = liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	int64_t peak = peakBytes.load(std::memory_order_relaxed);
+	while (peak < live && !peakBytes.compare_exchange_weak(peak, live,
+		std::memory_order_relaxed));
+	return h + 1;
+}
+
+//! Free counted block.
+static void
+countedFree(void *ptr)
+{
+	if (!ptr) return;
+	BlockHeader *h = (BlockHeader *)ptr - 1;
+	freeCount.fetch_add(1, std::memory_order_relaxed);
+	liveBytes.fetch_sub(h->bytes, std::memory_order_relaxed);
+	h->free(h);
+}
+
+void *
+operator new(size_t bytes)
+{
+	void *ptr = countedAlloc(bytes);
+	if (!ptr) throw std::bad_alloc();
+	return ptr;
+}
+
+void *
+operator new[](size_t bytes)
+{
+	void *ptr = countedAlloc(bytes);
+	if (!ptr) throw std::bad_alloc();
+	return ptr;
+}
+
+void *
+operator new(size_t bytes, const std::nothrow_t &) noexcept
+{
+	return countedAlloc(bytes);
+}
+
+void *
+operator new[](size_t bytes, const std::nothrow_t &) noexcept
+{
+	return countedAlloc(bytes);
+}
+
+void
+operator delete(void *ptr) noexcept
+{
+	countedFree(ptr);
+}
+
+void
+operator delete[](void *ptr) noexcept
+{
+	countedFree(ptr);
+}
+
+void
+operator delete(void *ptr, size_t) noexcept
+{
+	countedFree(ptr);
+}
+
+void
+operator delete[](void *ptr, size_t) noexcept
+{
+	countedFree(ptr);
+}
+
+void
+operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+	countedFree(ptr);
+}
+
+void
+operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+	countedFree(ptr);
+}
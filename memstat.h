@@ -0,0 +1,47 @@
+#ifndef __MEMSTAT_H__
+#define __MEMSTAT_H__
+
+#include <cstddef>
+#include <cstdint>
+
+//! Memory held by object.
+struct MemUsage
+{
+	//! Bytes held now (object and its buffers incl. reserved capacity).
+	int64_t live;
+	//! Bytes reserved but not in use (part of live).
+	int64_t unused;
+	//! The most bytes held at once (seen by changes of buffers).
+	int64_t peak;
+};
+
+//! Heap allocation counters of program (operator new and delete are replaced by
+//! memstat.o, programs not linked with it have no counters).
+struct AllocStat
+{
+	//! Number of allocations.
+	int64_t allocs;
+	//! Number of deallocations.
+	int64_t frees;
+	//! Bytes of all allocations.
+	int64_t bytes;
+	//! Bytes allocated now.
+	int64_t live;
+	//! The most bytes allocated at once (since resetAllocPeak()).
+	int64_t peak;
+};
+
+//! Allocator of blocks for operator new.
+typedef void *(*AllocHook)(size_t bytes);
+//! Deallocator of blocks of AllocHook.
+typedef void (*FreeHook)(void *ptr);
+
+//! Route operator new to given allocator (null for malloc and free). Every block is
+//! given back to the allocator it comes from.
+void setAllocHooks(AllocHook alloc, FreeHook free);
+//! Current allocation counters (all threads).
+AllocStat getAllocStat();
+//! Start peak of allocated bytes from bytes allocated now.
+void resetAllocPeak();
+
+#endif // __MEMSTAT_H__
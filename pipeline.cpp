@@ -0,0 +1,281 @@
+#include "pipeline.h"
+#include "kernels.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+
+//! Words of chunk whose distances are found at once.
+#define PART_WORDS 1024
+//! Maximum bits of frame accepted by decoder.
+#define FRAME_BITS_MAX (1 << 30)
+//! Distances counted by value when finding code word bits.
+#define HIST_DIST 1024
+//! Words of frame header.
+#define HEADER_WORDS ((int)(sizeof(FrameHeader) + 7) / 8)
+
+ChunkReader::ChunkReader(FILE *file, int chunkBytes):
+	mFile(file),
+	mChunkBytes(chunkBytes),
+	mCurrent(-1),
+	mStop(false)
+{
+	for (int b = 0; b < 2; b++) {
+		mBuffer[b].resize(chunkBytes / 8 + 1);
+		mSize[b] = 0;
+		mFull[b] = false;
+	}
+	if (pipe(mWake)) mWake[0] = mWake[1] = -1;
+	mThread = std::thread(&ChunkReader::run, this);
+}
+
+ChunkReader::~ChunkReader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mCond.notify_all();
+	// Closed pipe wakes reading thread waiting for input.
+	if (0 <= mWake[1]) close(mWake[1]);
+	mThread.join();
+	if (0 <= mWake[0]) close(mWake[0]);
+}
+
+int
+ChunkReader::next(const Word64 *&data)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	if (0 <= mCurrent) {
+		// Nothing follows the end of file or read error.
+		if (mSize[mCurrent] <= 0) return mSize[mCurrent];
+		mFull[mCurrent] = false;
+		mCond.notify_all();
+	}
+	mCurrent = (mCurrent + 1) % 2;
+	mCond.wait(lock, [this]() { return mFull[mCurrent]; });
+	data = mBuffer[mCurrent].data();
+	return mSize[mCurrent];
+}
+
+void
+ChunkReader::run()
+{
+	for (int b = 0; ; b ^= 1) {
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCond.wait(lock, [this, b]() { return mStop || !mFull[b]; });
+			if (mStop) return;
+		}
+		
+		// Buffer is not touched by consumer until it is full.
+		unsigned char *buf = (unsigned char *)mBuffer[b].data();
+		int size = 0;
+		bool error = false;
+		while (size < mChunkBytes) {
+			// Input or stop signal (destructor does not wait for input).
+			struct pollfd fds[2] = { { fileno(mFile), POLLIN, 0 }, { mWake[0], POLLIN, 0 } };
+			int ready = poll(fds, (0 <= mWake[0]) ? 2 : 1, -1);
+			if (ready < 0 && errno == EINTR) continue;
+			if (ready < 0 || fds[1].revents) {
+				error = ready < 0;
+				break;
+			}
+			ssize_t n = read(fileno(mFile), buf + size, mChunkBytes - size);
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) {
+				error = n < 0;
+				break;
+			}
+			size += n;
+		}
+		memset(buf + size, 0, 8*mBuffer[b].size() - size);
+		
+		bool stop;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mSize[b] = error ? -1 : size;
+			mFull[b] = true;
+			stop = mStop;
+		}
+		mCond.notify_all();
+		if (stop || error || !size) return;
+	}
+}
+
+StreamEncoder::StreamEncoder(Codec codec):
+	mCodec(codec == CODEC_RICE ? CODEC_RICE : CODEC_ACSBS),
+	mGap(0),
+	mDist(64*PART_WORDS),
+	mHist(HIST_DIST),
+	mFrame(HEADER_WORDS),
+	mFrameBytes(0)
+{
+}
+
+template <typename Op>
+int
+StreamEncoder::forDist(const Word64 *words, int bits, bool last, Op op) const
+{
+	int prev = -mGap - 1;
+	for (int begin = 0; begin < bits; begin += 64*PART_WORDS) {
+		int part = std::min(64*PART_WORDS, bits - begin);
+		int rel = prev - begin;
+		int n = kernels().findDist(words + begin / 64, part, &rel, mDist.data());
+		prev = rel + begin;
+		if (n) op(mDist.data(), n);
+	}
+	// The last 'virtual' one.
+	if (last) {
+		mDist[0] = bits - prev - 1;
+		op(mDist.data(), 1);
+	}
+	return prev;
+}
+
+//! Add code word size of long distance by word bits.
+static void
+addCost(Codec codec, int64_t d, int64_t count, int64_t *total)
+{
+	for (int w = 0; w < WORD_BITS_MAX; w++) {
+		if (codec == CODEC_ACSBS) {
+			total[w] += w ? count*w*(d / ((1 << w) - 1) + 1) : 0;
+		} else {
+			total[w] += count*((d >> w) + 1 + w);
+		}
+	}
+}
+
+bool
+StreamEncoder::writeFrame(const Word64 *words, int bits, bool last)
+{
+	// Distances (incl. the carried gap) have to fit int.
+	if (INT_MAX - 1 - bits < mGap) return false;
+	
+	// The first pass finds optimal code word bits (short distances are counted).
+	int64_t total[WORD_BITS_MAX] = {0};
+	int count = 0;
+	std::fill(mHist.begin(), mHist.end(), 0);
+	forDist(words, bits, last, [&](const int *dist, int n) {
+		for (int i = 0; i < n; i++) {
+			if (dist[i] < HIST_DIST) {
+				mHist[dist[i]]++;
+			} else {
+				addCost(mCodec, dist[i], 1, total);
+			}
+		}
+		count += n;
+	});
+	for (int d = 0; d < HIST_DIST; d++) {
+		if (mHist[d]) addCost(mCodec, d, mHist[d], total);
+	}
+	int w = mCodec == CODEC_ACSBS ? 1 : 0;
+	for (int i = w + 1; i < WORD_BITS_MAX; i++) {
+		if (total[i] < total[w]) w = i;
+	}
+	if (INT_MAX - 64 < total[w]) return false;
+	
+	FrameHeader header = { (uint32_t)bits, (uint32_t)count, (uint32_t)total[w],
+		(uint8_t)mCodec, (uint8_t)w, (uint8_t)last, 0 };
+	int words64 = HEADER_WORDS + (total[w] + 63) / 64;
+	if ((int)mFrame.size() < words64) mFrame.resize(words64);
+	memset(mFrame.data(), 0, 8*words64);
+	memcpy(mFrame.data(), &header, sizeof(header));
+	
+	// The second pass writes code words.
+	Word64 *enc = mFrame.data() + HEADER_WORDS;
+	int encBits = 0;
+	int prev = forDist(words, bits, last, [&](const int *dist, int n) {
+		if (mCodec == CODEC_ACSBS) {
+			encBits = kernels().acsbsEncode(dist, n, w, enc, encBits);
+		} else {
+			encBits = kernels().riceEncode(dist, n, w, enc, encBits);
+		}
+	});
+	mGap = bits - prev - 1;
+	mFrameBytes = 8*words64;
+	return true;
+}
+
+bool
+StreamEncoder::encode(const Word64 *words, int bits)
+{
+	return writeFrame(words, bits, false);
+}
+
+bool
+StreamEncoder::finish()
+{
+	return writeFrame(0, 0, true);
+}
+
+const void *
+StreamEncoder::frame() const
+{
+	return mFrame.data();
+}
+
+int
+StreamEncoder::frameBytes() const
+{
+	return mFrameBytes;
+}
+
+StreamDecoder::StreamDecoder():
+	mGap(0),
+	mDist(64*PART_WORDS)
+{
+}
+
+int
+StreamDecoder::decode(FILE *file, const Word64 *&words, int &bits)
+{
+	// Nothing follows the last frame.
+	if (mGap < 0) return 0;
+	
+	FrameHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1) return -1;
+	int w = header.wordBits;
+	bool acsbs = header.codec == CODEC_ACSBS;
+	if ((!acsbs && header.codec != CODEC_RICE) || WORD_BITS_MAX <= w || (acsbs && !w) ||
+		FRAME_BITS_MAX < header.bits || header.bits + 1 < header.count ||
+		INT_MAX - 64*(DECODE_PAD_WORDS + 1) < header.encBits) return -1;
+	bits = header.bits;
+	
+	// Code words with padding of decoders.
+	int encBits = header.encBits;
+	int encWords = (encBits + 63) / 64;
+	mEnc.resize(encWords + DECODE_PAD_WORDS);
+	if ((int)fread(mEnc.data(), 8, encWords, file) != encWords) return -1;
+	memset(mEnc.data() + encWords, 0, 8*DECODE_PAD_WORDS);
+	mWords.assign((bits + 63) / 64, 0);
+	
+	// Ones of frame (the 'virtual' one has to end the last frame exactly).
+	int64_t prev = -mGap - 1;
+	int begin = 0;
+	for (int rest = header.count; 0 < rest; ) {
+		int n = acsbs ?
+			kernels().acsbsDecode(mEnc.data(), &begin, encBits, w, mDist.data(),
+				std::min(rest, (int)mDist.size())) :
+			kernels().riceDecode(mEnc.data(), &begin, encBits, w, mDist.data(),
+				std::min(rest, (int)mDist.size()));
+		if (n <= 0) return -1;
+		rest -= n;
+		if (header.last && !rest) n--;
+		for (int i = 0; i < n; i++) {
+			prev += mDist[i] + 1;
+			// Ones of previous frames are past already.
+			if (prev < 0 || bits <= prev) return -1;
+			mWords[prev / 64] |= (Word64)1 << (prev % 64);
+		}
+		if (header.last && !rest && prev + mDist[n] + 1 != bits) return -1;
+	}
+	if (begin != encBits || (header.last && !header.count)) return -1;
+	
+	mGap = header.last ? -1 : bits - prev - 1;
+	words = mWords.data();
+	return 1;
+}
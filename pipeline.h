@@ -0,0 +1,139 @@
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include "compress.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! Header of frame of streamed encoding (code words follow in 64-bit words).
+struct FrameHeader
+{
+	//! Bits of bitmap in frame.
+	uint32_t bits;
+	//! Number of distances (the first one counts from the last one of previous frames,
+	//! the last frame has only the 'virtual' one).
+	uint32_t count;
+	//! Bits of code words.
+	uint32_t encBits;
+	//! Codec (AC-SBS or Rice-Golomb).
+	uint8_t codec;
+	//! Code word bits.
+	uint8_t wordBits;
+	//! Last frame of stream.
+	uint8_t last;
+	//! Reserved (zero).
+	uint8_t reserved;
+};
+
+//! Double-buffered reader of file by chunks: the next chunk is read in background
+//! thread while the current one is processed. Reading thread waits for input together
+//! with stop signal, so reader is destroyed at once even if input (e.g. terminal or
+//! pipe) has nothing to read.
+class ChunkReader
+{
+public:
+	//! Start reading of file by chunks of given bytes (multiple of 8).
+	ChunkReader(FILE *file, int chunkBytes);
+	ChunkReader(const ChunkReader &) = delete;
+	~ChunkReader();
+
+	//! Next chunk as words (bytes past its end are zero), returns its bytes (0 at the end
+	//! of file, -1 for read error). The previous chunk is given back for reading.
+	int next(const Word64 *&data);
+
+protected:
+	//! Reading thread.
+	void run();
+
+private:
+	//! Input file.
+	FILE *mFile;
+	//! Bytes of chunk.
+	int mChunkBytes;
+	//! Chunk buffers.
+	std::vector<Word64> mBuffer[2];
+	//! Bytes read into buffers (-1 for read error).
+	int mSize[2];
+	//! Buffer is read and waits for processing.
+	bool mFull[2];
+	//! Buffer given by next() (-1 before the first chunk).
+	int mCurrent;
+	//! Reading thread has to stop.
+	bool mStop;
+	//! Pipe waking reading thread waiting for input (-1 if it cannot be created).
+	int mWake[2];
+	//! Lock of buffer state.
+	std::mutex mMutex;
+	//! Signal of buffer state change.
+	std::condition_variable mCond;
+	//! Reading thread.
+	std::thread mThread;
+};
+
+//! Encoder of bitmap arriving by chunks into frames (gap after the last one is carried
+//! to the next chunk, memory does not depend on stream length).
+class StreamEncoder
+{
+public:
+	//! Encoder using AC-SBS or Rice-Golomb.
+	StreamEncoder(Codec codec = CODEC_ACSBS);
+
+	//! Encode chunk of packed bits into frame with optimal code word bits, false if
+	//! a distance does not fit int.
+	bool encode(const Word64 *words, int bits);
+	//! Encode the last frame with the 'virtual' distance only.
+	bool finish();
+	//! Frame of the last encoded chunk.
+	const void *frame() const;
+	//! Bytes of the last frame.
+	int frameBytes() const;
+
+protected:
+	//! Distances of chunk by parts, the first one counts from the last one of previous
+	//! chunks (op gets distances and their number), returns position of the last one.
+	template <typename Op>
+	int forDist(const Word64 *words, int bits, bool last, Op op) const;
+	//! Encode distances of chunk into frame.
+	bool writeFrame(const Word64 *words, int bits, bool last);
+
+private:
+	//! Codec of frames.
+	Codec mCodec;
+	//! Zeros after the last one of previous chunks.
+	int64_t mGap;
+	//! Distances of part of chunk.
+	mutable std::vector<int> mDist;
+	//! Number of short distances of chunk by value.
+	std::vector<int> mHist;
+	//! Header and code words of frame.
+	std::vector<Word64> mFrame;
+	//! Bytes of frame.
+	int mFrameBytes;
+};
+
+//! Decoder of frames of StreamEncoder.
+class StreamDecoder
+{
+public:
+	StreamDecoder();
+
+	//! Decode next frame from file into packed bits (bits receives their number), returns
+	//! 1 for frame, 0 after the last frame and -1 for malformed or truncated stream.
+	int decode(FILE *file, const Word64 *&words, int &bits);
+
+private:
+	//! Zeros after the last one of previous frames.
+	int64_t mGap;
+	//! Code words of frame (with padding of decoders).
+	std::vector<Word64> mEnc;
+	//! Decoded bitmap of frame.
+	std::vector<Word64> mWords;
+	//! Decoded distances by parts.
+	std::vector<int> mDist;
+};
+
+#endif // __PIPELINE_H__
@@ -0,0 +1,108 @@
+#include "snapshot.h"
+#include "kernels.h"
+
+#include <cstring>
+
+SnapshotSeries::SnapshotSeries(int keyInterval):
+	mKeyInterval(keyInterval < 1 ? 1 : keyInterval),
+	mRef(std::vector<int>(1, 0))
+{
+	clear();
+}
+
+void
+SnapshotSeries::clear()
+{
+	mArena.assign(DECODE_PAD_WORDS, 0);
+	mFrames.clear();
+	mRef.setDist(std::vector<int>(1, 0));
+}
+
+void
+SnapshotSeries::add(const BitString &bs)
+{
+	static thread_local std::vector<int> dist;
+	static thread_local BitString frame(std::vector<int>(1, 0));
+	static const BitString empty(0);
+	
+	// Only bits flipped since the last snapshot are kept (keyframe is delta of empty string).
+	bs.xorDist(isKeyframe(mFrames.size()) ? empty : mRef, dist);
+	frame.setDist(dist);
+	frame.setAutoDistEnc();
+	
+	// Code words of frame follow the previous one in arena (its encoder is reused).
+	int encBits;
+	const Word64 *enc = frame.getEnc(CODEC_AUTO, encBits);
+	int64_t offset = mArena.size() - DECODE_PAD_WORDS;
+	int words = (encBits + 63) / 64;
+	mArena.resize(offset + words + DECODE_PAD_WORDS, 0);
+	memcpy(mArena.data() + offset, enc, 8*words);
+	mFrames.push_back(SnapshotFrame{ offset, encBits, frame.getBits(), frame.getOnes() });
+	
+	// Reference keeps distances of snapshot only.
+	dist.resize(bs.getOnes() + 1);
+	bs.getDist(0, dist.size(), dist.data());
+	mRef.setDist(dist);
+}
+
+bool
+SnapshotSeries::get(int i, BitString &bs) const
+{
+	static thread_local std::vector<int> dist;
+	
+	// Decode the nearest keyframe and apply deltas after it.
+	int key = i - i % mKeyInterval;
+	for (int j = key; j <= i; j++) {
+		const SnapshotFrame &f = mFrames[j];
+		if (!BitString::getTaggedDist(mArena.data() + f.offset, f.encBits, f.bits, f.ones, dist)) {
+			return false;
+		}
+		if (j == key) {
+			bs.setDist(dist);
+		} else {
+			bs.flipDist(dist);
+		}
+	}
+	if (key < i) bs.findDist();
+	return true;
+}
+
+int
+SnapshotSeries::size() const
+{
+	return mFrames.size();
+}
+
+bool
+SnapshotSeries::isKeyframe(int i) const
+{
+	return i % mKeyInterval == 0;
+}
+
+int
+SnapshotSeries::getEncBits(int i) const
+{
+	return mFrames[i].encBits;
+}
+
+long
+SnapshotSeries::getEncBits() const
+{
+	long bits = 0;
+	for (const SnapshotFrame &f: mFrames) bits += f.encBits;
+	return bits;
+}
+
+MemUsage
+SnapshotSeries::getMemUsage() const
+{
+	// Reference is counted by its own usage (its object is part of series).
+	MemUsage ref = mRef.getMemUsage();
+	MemUsage mem;
+	mem.live = sizeof(*this) - sizeof(mRef) + ref.live;
+	mem.live += sizeof(Word64)*mArena.capacity() + sizeof(SnapshotFrame)*mFrames.capacity();
+	mem.unused = ref.unused + sizeof(Word64)*(mArena.capacity() - mArena.size());
+	mem.unused += sizeof(SnapshotFrame)*(mFrames.capacity() - mFrames.size());
+	mem.peak = mem.live;
+	return mem;
+}
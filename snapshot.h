@@ -0,0 +1,61 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include "compress.h"
+
+#include <vector>
+
+//! Header of encoded snapshot (code words are in arena of series).
+struct SnapshotFrame
+{
+	//! Word of arena with the first code word.
+	int64_t offset;
+	//! Bits of tagged encoding.
+	int encBits;
+	//! Bits of snapshot.
+	int bits;
+	//! Number of flipped bits (ones of delta).
+	int ones;
+};
+
+//! Time series of bitstrings of the same length encoded as deltas (XOR against previous
+//! snapshot) with periodic keyframes.
+class SnapshotSeries
+{
+public:
+	//! Series with keyframe every keyInterval snapshots.
+	SnapshotSeries(int keyInterval = 32);
+
+	//! Remove all snapshots.
+	void clear();
+	//! Encode next snapshot (its distances have to be found).
+	void add(const BitString &bs);
+	//! Reconstruct snapshot with given index, false if encoding of a frame is malformed
+	//! (decoding stops at it and bitmap is left partial).
+	bool get(int i, BitString &bs) const;
+
+	//! Number of snapshots.
+	int size() const;
+	//! Check if snapshot with given index is a keyframe.
+	bool isKeyframe(int i) const;
+	//! Encoding size of snapshot with given index in bits.
+	int getEncBits(int i) const;
+	//! Encoding size of all snapshots in bits.
+	long getEncBits() const;
+	//! Memory held by series: code words, headers and distances of the last snapshot.
+	MemUsage getMemUsage() const;
+
+private:
+	//! Snapshots between keyframes.
+	int mKeyInterval;
+	//! Tagged encodings of keyframes and deltas (distances between flipped bits) one
+	//! after another from word boundaries (with padding of decoders).
+	std::vector<Word64> mArena;
+	//! Headers of keyframes and deltas.
+	std::vector<SnapshotFrame> mFrames;
+	//! Distances of the last snapshot (reference of the next delta, no bitmap or
+	//! encoding).
+	BitString mRef;
+};
+
+#endif // __SNAPSHOT_H__
@@ -1,5 +1,12 @@
 #include "compress.h"
+#include "corpus.h"
+#include "kernels.h"
+#include "memstat.h"
+#include "snapshot.h"
+#include "store.h"
+#include "workload.h"
 
+#include <chrono>
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
@@ -12,7 +19,86 @@ const char *help =
 	"-max\tMaximum number of ones in sequence (maximum k).\n"
 	"-s\tStep to the next k.\n"
 	"-l\tNumber of tested sequences.\n"
-	"-z\tTurn off ZLIB.\n";
+	"-z\tTurn off ZLIB.\n"
+	"-zl\tZLIB compression level (0..9, -1 for zlib default).\n"
+	"-zs\tZLIB strategy (default, filtered, huffman, rle, fixed).\n"
+	"-isa\tForce codec kernels (scalar, sse4.2, avx2, avx512).\n"
+	"-f\tTest distance extraction and code word bits search (findDist).\n"
+	"-t\tThreads of distance extraction (0 for all cores).\n"
+	"-q\tTest rank/select directory (build, 1000 random rank and select queries).\n"
+	"-b\tTest batch (interleaved) decompression.\n"
+	"-i\tAdd ones to sequences with incremental distance update.\n"
+	"-w\tGenerate sequences by workload (uniform, markov:run, powerlaw:exponent,\n"
+	"\tperiodic:jitter, burst:size:gap).\n"
+	"-ws\tSeed of workload generator.\n"
+	"-c\tTest sequences of corpus file or directory (*.bits, *.pos) instead of random ones.\n"
+	"-cb\tBits of sequences in raw corpus files (0 = whole file).\n"
+	"-r\tClustered ones in runs of given mean length (adds run-pair AC-SBS test).\n"
+	"-g\tTest store of all sequences in one arena (build, decompression by ID, bytes).\n"
+	"-d\tTest delta encoding of successive sequences (keyframe interval).\n"
+	"-a\tTest automatic codec selection.\n"
+	"-m\tMemory held by sequence (live, unused, peak bytes) and heap allocations per operation.\n"
+	"-aw\tBits of encoding worth one nanosecond of decoding (automatic selection).\n"
+	"-ac\tCalibrate decoding time model of automatic selection (after -isa, before -aw\n"
+	"\tis applied, whatever the order of options).\n"
+	"Times [us] are wall time (steady clock), not CPU time that threads of -t add up.\n";
+
+//! Average time [us] of operation on every sequence (B is adjusted to about 1s test).
+template <typename Op>
+static double
+measure(std::vector<BitString> &bsVec, int &B, Op op)
+{
+	int l = bsVec.size();
+	// Wall time (parallel operations would add up CPU time of all threads).
+	auto t = std::chrono::steady_clock::now();
+	for (int i = 0; i < l; i++) {
+		for (int j = 0; j < B; j++) {
+			op(bsVec[i]);
+		}
+	}
+	double avgT = std::chrono::duration<double, std::micro>(
+		std::chrono::steady_clock::now() - t).count();
+	
+	avgT /= l*B; // Average time in micro-seconds.
+	if (1E6 < l*B*avgT) { // Adjust test time to about 1s.
+		B = 1E6 / (l*avgT) + 1;
+	}
+	
+	return avgT;
+}
+
+//! Average number of heap allocations of operation on every sequence (run once).
+template <typename Op>
+static double
+countAllocs(std::vector<BitString> &bsVec, Op op)
+{
+	int64_t allocs = getAllocStat().allocs;
+	for (BitString &bs: bsVec) {
+		op(bs);
+	}
+	return (double)(getAllocStat().allocs - allocs) / bsVec.size();
+}
+
+//! Average time [us] per sequence of operation on all sequences at once.
+template <typename Op>
+static double
+measureAll(int l, int &B, Op op)
+{
+	// Wall time (parallel operations would add up CPU time of all threads).
+	auto t = std::chrono::steady_clock::now();
+	for (int j = 0; j < B; j++) {
+		op();
+	}
+	double avgT = std::chrono::duration<double, std::micro>(
+		std::chrono::steady_clock::now() - t).count();
+	
+	avgT /= l*B; // Average time in micro-seconds.
+	if (1E6 < l*B*avgT) { // Adjust test time to about 1s.
+		B = 1E6 / (l*avgT) + 1;
+	}
+	
+	return avgT;
+}
 
 int
 main(int argc, char *argv[])
@@ -29,10 +115,42 @@ main(int argc, char *argv[])
 	int l = 1;
 	// Default option to test ZLIB.
 	int z = 1;
-	// Average time.
-	double avgT;
-	// Current time.
-	clock_t t;
+	// Default ZLIB compression level.
+	int zLevel = -1;
+	// Default ZLIB strategy.
+	ZlibStrategy zStrategy = ZLIB_DEFAULT;
+	// Default option to test automatic codec selection.
+	int a = 0;
+	// Default option to update distances incrementally.
+	int inc = 0;
+	// Default option to test batch decompression.
+	int batch = 0;
+	// Default option to test distance extraction.
+	int f = 0;
+	// Default option to test rank/select directory.
+	int q = 0;
+	// Default workload generator (none = ones at random).
+	Workload workload;
+	int w = 0;
+	// Default corpus (none = generated sequences).
+	std::string c;
+	int cBits = 0;
+	// Default mean length of runs of ones (0 = ones at random).
+	int r = 0;
+	// Default keyframe interval of delta encoding (0 = no test).
+	int d = 0;
+	// Default option to test store of sequences.
+	int g = 0;
+	// Default option to print memory statistics.
+	int m = 0;
+	// Default codec kernels (empty = detected).
+	std::string isa;
+	// Default threads of distance extraction (-1 = unchanged).
+	int threads = -1;
+	// Default weight of decoding time in automatic selection (negative = unchanged).
+	double autoWeight = -1;
+	// Default option to calibrate automatic selection.
+	int autoCalibrate = 0;
 	
 	while (*(++argv)) {
 		// Number of bits in sequence.
@@ -53,177 +171,412 @@ main(int argc, char *argv[])
 		// Turn off ZLIB.
 		} else if (*argv == std::string("-z")) {
 			z = 0;
+		// ZLIB compression level.
+		} else if (*argv == std::string("-zl")) {
+			zLevel = std::stoi(*(++argv));
+		// ZLIB strategy.
+		} else if (*argv == std::string("-zs")) {
+			std::string strategy(*(++argv));
+			if (strategy == "default") {
+				zStrategy = ZLIB_DEFAULT;
+			} else if (strategy == "filtered") {
+				zStrategy = ZLIB_FILTERED;
+			} else if (strategy == "huffman") {
+				zStrategy = ZLIB_HUFFMAN_ONLY;
+			} else if (strategy == "rle") {
+				zStrategy = ZLIB_RLE;
+			} else if (strategy == "fixed") {
+				zStrategy = ZLIB_FIXED;
+			} else {
+				printf("%s", help);
+				return 0;
+			}
+		// Force codec kernels.
+		} else if (*argv == std::string("-isa")) {
+			isa = *(++argv);
+		// Test distance extraction.
+		} else if (*argv == std::string("-f")) {
+			f = 1;
+		// Threads of distance extraction.
+		} else if (*argv == std::string("-t")) {
+			threads = std::stoi(*(++argv));
+		// Test rank/select directory.
+		} else if (*argv == std::string("-q")) {
+			q = 1;
+		// Test batch decompression.
+		} else if (*argv == std::string("-b")) {
+			batch = 1;
+		// Update distances incrementally.
+		} else if (*argv == std::string("-i")) {
+			inc = 1;
+		// Workload generator.
+		} else if (*argv == std::string("-w")) {
+			if (!workload.parse(*(++argv))) {
+				printf("%s", help);
+				return 0;
+			}
+			w = 1;
+		// Seed of workload generator.
+		} else if (*argv == std::string("-ws")) {
+			workload.seed(std::stoull(*(++argv)));
+		// Corpus of sequences.
+		} else if (*argv == std::string("-c")) {
+			c = *(++argv);
+		// Bits of sequences in raw corpus files.
+		} else if (*argv == std::string("-cb")) {
+			cBits = std::stoi(*(++argv));
+		// Clustered ones.
+		} else if (*argv == std::string("-r")) {
+			r = std::stoi(*(++argv));
+		// Test store of sequences.
+		} else if (*argv == std::string("-g")) {
+			g = 1;
+		// Test delta encoding.
+		} else if (*argv == std::string("-d")) {
+			d = std::stoi(*(++argv));
+		// Test automatic codec selection.
+		} else if (*argv == std::string("-a")) {
+			a = 1;
+		// Memory statistics.
+		} else if (*argv == std::string("-m")) {
+			m = 1;
+		// Weight of decoding time in automatic codec selection.
+		} else if (*argv == std::string("-aw")) {
+			autoWeight = std::stod(*(++argv));
+		// Calibrate automatic codec selection.
+		} else if (*argv == std::string("-ac")) {
+			autoCalibrate = 1;
 		} else {
 			printf("%s", help);
 			return 0;
 		}
 	}
+	
+	// Options are applied after all are read (calibration measures kernels in use).
+	if (!isa.empty() && !setKernelIsa(isa.c_str())) {
+		std::cerr << "Kernels " << isa << " are not supported." << std::endl;
+		return 1;
+	}
+	if (0 <= threads) BitString::setThreads(threads);
+	if (autoCalibrate) BitString::calibrateAutoCost();
+	if (0 <= autoWeight) BitString::setAutoCostWeight(autoWeight);
 
 	// Iteration bounds for speed test.
-	int B1, B2, B3;
-	B1 = B2 = B3 = 1;
+	int B1, B2, B3, B4, B5, B6, B7, B8, B9, B10, B11, B12;
+	B1 = B2 = B3 = B4 = B5 = B6 = B7 = B8 = B9 = B10 = B11 = B12 = 1;
 	
 	srand(clock());
 
+	// Corpus is tested at once (single row of totals).
+	Corpus corpus;
+	int64_t cOnes = 0, cBitsTotal = 0;
+	if (!c.empty()) {
+		if (!corpus.load(c, cBits)) return 1;
+		if (!corpus.size()) {
+			std::cerr << "Empty corpus " << c << "." << std::endl;
+			return 1;
+		}
+		l = corpus.size();
+		kMax = kMin + 1;
+		s = 1;
+		inc = 0;
+	}
+
 	// Generation of sequences to test.
 	std::vector<BitString> bsVec;
 	std::vector<int> v;
+	// Results of rank/select queries (kept to avoid optimizing them out).
+	int64_t sum = 0;
+	// Sequences and output buffers for batch decompression.
+	std::vector<const BitString *> bsPtr;
+	std::vector<std::vector<int> > distVec(l);
+	std::vector<int *> distPtr(l);
+	// Delta encoded history of every sequence.
+	std::vector<SnapshotSeries> series(l, SnapshotSeries(d));
+	BitString snapshot;
+	// Store of all sequences.
+	BitmapStore store;
 	
 	for (int i = 0; i < l; i++) {
 		bsVec.push_back(BitString(n));
-		bsVec[i].random(kMin);
+		if (!c.empty()) {
+			corpus.get(i, bsVec[i]);
+			cOnes += bsVec[i].getOnes();
+			cBitsTotal += corpus.bits(i);
+		} else if (w) {
+			workload.generate(n, kMin, v);
+			bsVec[i].flipDist(v);
+		} else if (r) {
+			bsVec[i].randomRuns(kMin, r);
+		} else {
+			bsVec[i].random(kMin);
+		}
 		bsVec[i].findDist();
+		bsVec[i].setZlibParams(zLevel, zStrategy);
+	}
+	for (int i = 0; i < l; i++) {
+		bsPtr.push_back(&bsVec[i]);
 	}
 	
 	// Print headers.
+	if (!c.empty()) {
+		std::cout << "corpus=" << c << std::endl;
+		n = cBitsTotal / l;
+	}
 	std::cout << "n=" << n << std::endl;
 	std::cout << "l=" << l << std::endl;
-	std::cout << "k/n\tk\tAC-SBS (comp.) [us]\tAC-SBS (decomp.) [us]";
+	std::cout << "isa=" << kernels().name << std::endl;
+	if (w) std::cout << "workload=" << workload.name() << std::endl;
+	std::cout << "k/n\tk";
+	if (f) {
+		std::cout << "\tfindDist [us]";
+	}
+	if (q) {
+		std::cout << "\tRank (build) [us]\tRank (1000x) [us]\tSelect (1000x) [us]";
+	}
+	std::cout << "\tAC-SBS (comp.) [us]\tAC-SBS (decomp.) [us]";
 	std::cout << "\tRice-Golomb (comp.) [us]\tRice-Golomb (decomp.) [us]";
+	if (r) {
+		std::cout << "\tAC-SBS runs (comp.) [us]\tAC-SBS runs (decomp.) [us]";
+		std::cout << "\tAC-SBS runs (bitmap decomp.) [us]";
+	}
+	if (batch) {
+		std::cout << "\tAC-SBS (batch decomp.) [us]\tRice-Golomb (batch decomp.) [us]";
+	}
 	if (z) {
 		std::cout << "\tZ-LIB (comp.) [us]\tZ-LIB (decomp.) [us]";
 	}
+	if (a) {
+		std::cout << "\tAuto (comp.) [us]\tAuto (decomp.) [us]\tAuto codec";
+	}
+	if (d) {
+		std::cout << "\tDelta (comp.) [us]\tDelta (decomp.) [us]\tDelta [bits]\tSeries [B]";
+	}
+	if (g) {
+		std::cout << "\tStore (comp.) [us]\tStore (decomp.) [us]\tStore [B]";
+	}
+	if (m) {
+		std::cout << "\tMemory [B]\tMemory unused [B]\tMemory peak [B]";
+		std::cout << "\tAC-SBS (comp.) [allocs]\tAC-SBS (decomp.) [allocs]";
+		std::cout << "\tRice-Golomb (comp.) [allocs]\tRice-Golomb (decomp.) [allocs]";
+	}
 	std::cout << std::endl;
 
 	// Measure compression/decompression time.
 	for (int k = kMin; k < kMax; k += s) {
-		std::cout << std::setprecision(4) << (double)k / n << "\t" << k;
+		if (!c.empty()) {
+			// Totals of corpus instead of k.
+			std::cout << std::setprecision(4) << (double)cOnes / cBitsTotal << "\t" << cOnes / l;
+		} else {
+			std::cout << std::setprecision(4) << (double)k / n << "\t" << k;
+		}
 
 		// =============================================================
-		// Speed of AC-SBS
+		// Speed of distance extraction
 		// =============================================================
 		
-		// Compression time.
-		avgT = 0;
-		t = clock();
-		for (int i = 0; i < l; i++) {
-			for (int j = 0; j < B1; j++) {
-				bsVec[i].setAcsbsDistEnc();
-			}
+		if (f) {
+			std::cout << "\t" << measure(bsVec, B7, [](BitString &bs) {
+				bs.findDist();
+			});
 		}
-		avgT += clock() - t;
+
+		// =============================================================
+		// Speed of rank/select directory
+		// =============================================================
 		
-		avgT /= l*B1; // Average time in clocks.
-		if (CLOCKS_PER_SEC < l*B1*avgT) { // Adjust test time to about 1s.
-			B1 = CLOCKS_PER_SEC / (l*avgT) + 1;
+		if (q) {
+			std::cout << "\t" << measure(bsVec, B10, [](BitString &bs) {
+				bs.clearRank();
+				bs.buildRank();
+			});
+			std::cout << "\t" << measure(bsVec, B10, [&sum](BitString &bs) {
+				for (int j = 0; j < 1000; j++) sum += bs.rank(rand() % bs.getBits());
+			});
+			std::cout << "\t" << measure(bsVec, B10, [&sum](BitString &bs) {
+				int ones = bs.getOnes();
+				for (int j = 0; ones && j < 1000; j++) sum += bs.select(rand() % ones);
+			});
 		}
-		avgT /= CLOCKS_PER_SEC; // Average time in seconds.
-		avgT *= 1E6; // Average time in micro-seconds.
-		std::cout << "\t" << avgT;
-
-		// Decompression time.
-		avgT = 0;
-		t = clock();
-		for (int i = 0; i < l; i++) {
-			for (int j = 0; j < B1; j++) {
-				bsVec[i].getAcsbsDistEnc(v);
-			}
-		}
-		avgT += clock() - t;
 
-		avgT /= l*B1; // Average time in clocks.
-		if (CLOCKS_PER_SEC < l*B1*avgT) { // Adjust test time to about 1s.
-			B1 = CLOCKS_PER_SEC / (l*avgT) + 1;
-		}
-		avgT /= CLOCKS_PER_SEC; // Average time in seconds.
-		avgT *= 1E6; // Average time in micro-seconds.
-		std::cout << "\t" << avgT;
+		// =============================================================
+		// Speed of AC-SBS
+		// =============================================================
+		
+		std::cout << "\t" << measure(bsVec, B1, [](BitString &bs) {
+			bs.clearEnc();
+			bs.setAcsbsDistEnc();
+		});
+		std::cout << "\t" << measure(bsVec, B1, [&v](BitString &bs) {
+			bs.getAcsbsDistEnc(v);
+		});
 
 		// =============================================================
 		// Speed of Rice-Golomb
 		// =============================================================
 
-		// Compression time.
-		avgT = 0;
-		t = clock();
-		for (int i = 0; i < l; i++) {
-			for (int j = 0; j < B2; j++) {
-				bsVec[i].setRiceDistEnc();
-			}
-		}
-		avgT += clock() - t;
+		std::cout << "\t" << measure(bsVec, B2, [](BitString &bs) {
+			bs.clearEnc();
+			bs.setRiceDistEnc();
+		});
+		std::cout << "\t" << measure(bsVec, B2, [&v](BitString &bs) {
+			bs.getRiceDistEnc(v);
+		});
+
+		// =============================================================
+		// Speed of run-pair AC-SBS
+		// =============================================================
 		
-		avgT /= l*B2; // Average time in clocks.
-		if (CLOCKS_PER_SEC < l*B2*avgT) { // Adjust test time to about 1s.
-			B2 = CLOCKS_PER_SEC / (l*avgT) + 1;
+		if (r) {
+			std::vector<Word64> words;
+			std::cout << "\t" << measure(bsVec, B9, [](BitString &bs) {
+				bs.clearEnc();
+				bs.setRunDistEnc();
+			});
+			std::cout << "\t" << measure(bsVec, B9, [&v](BitString &bs) {
+				bs.getRunDistEnc(v);
+			});
+			std::cout << "\t" << measure(bsVec, B9, [&words](BitString &bs) {
+				bs.getRunBitsEnc(words);
+			});
 		}
-		avgT /= CLOCKS_PER_SEC; // Average time in seconds.
-		avgT *= 1E6; // Average time in micro-seconds.
-		std::cout << "\t" << avgT;
-
-		// Decompression time.
-		avgT = 0;
-		t = clock();
-		for (int i = 0; i < l; i++) {
-			for (int j = 0; j < B2; j++) {
-				bsVec[i].getRiceDistEnc(v);
-			}
-		}
-		avgT += clock() - t;
-		
 
-		avgT /= l*B2; // Average time in clocks.
-		if (CLOCKS_PER_SEC < l*B2*avgT) { // Adjust test time to about 1s.
-			B2 = CLOCKS_PER_SEC / (l*avgT) + 1;
+		// =============================================================
+		// Speed of batch decompression
+		// =============================================================
+		
+		if (batch) {
+			for (int i = 0; i < l; i++) {
+				distVec[i].resize(bsVec[i].getOnes() + 1);
+				distPtr[i] = distVec[i].data();
+			}
+			for (int i = 0; i < l; i++) {
+				bsVec[i].setAcsbsDistEnc();
+			}
+			std::cout << "\t" << measureAll(l, B5, [&]() {
+				BitString::getAcsbsDistEncBatch(bsPtr.data(), l, distPtr.data());
+			});
+			for (int i = 0; i < l; i++) {
+				bsVec[i].setRiceDistEnc();
+			}
+			std::cout << "\t" << measureAll(l, B6, [&]() {
+				BitString::getRiceDistEncBatch(bsPtr.data(), l, distPtr.data());
+			});
 		}
-		avgT /= CLOCKS_PER_SEC; // Average time in seconds.
-		avgT *= 1E6; // Average time in micro-seconds.
-		std::cout << "\t" << avgT;
 
 		// =============================================================
 		// Speed of ZLIB Deflate
 		// =============================================================
 		
-		if (!z) {
-			std::cout << std::endl << std::flush;
-			continue;
+		if (z) {
+			std::cout << "\t" << measure(bsVec, B3, [](BitString &bs) {
+				bs.clearEnc();
+				bs.setZlibDistEnc();
+			});
+			std::cout << "\t" << measure(bsVec, B3, [&v](BitString &bs) {
+				bs.getZlibDistEnc(v);
+			});
 		}
+
+		// =============================================================
+		// Speed of automatic codec selection
+		// =============================================================
 		
-		// Compression time.
-		avgT = 0;
-		t = clock();
-		for (int i = 0; i < l; i++) {
-			for (int j = 0; j < B3; j++) {
-				bsVec[i].setZlibDistEnc();
-			}
+		if (a) {
+			std::cout << "\t" << measure(bsVec, B4, [](BitString &bs) {
+				bs.clearEnc();
+				bs.setAutoDistEnc();
+			});
+			std::cout << "\t" << measure(bsVec, B4, [&v](BitString &bs) {
+				bs.getAutoDistEnc(v);
+			});
+			std::cout << "\t" << bsVec[0].getEncCodec();
 		}
-		avgT += clock() - t;
+
+		// =============================================================
+		// Speed of delta encoding
+		// =============================================================
 		
-		avgT /= l*B3; // Average time in clocks.
-		if (CLOCKS_PER_SEC < l*B3*avgT) { // Adjust test time to about 1s.
-			B3 = CLOCKS_PER_SEC / (l*avgT) + 1;
+		if (d) {
+			// Every snapshot is added once.
+			int once = 1;
+			std::cout << "\t" << measureAll(l, once, [&]() {
+				for (int i = 0; i < l; i++) series[i].add(bsVec[i]);
+			});
+			std::cout << "\t" << measureAll(l, B8, [&]() {
+				for (int i = 0; i < l; i++) series[i].get(series[i].size() - 1, snapshot);
+			});
+			std::cout << "\t" << series[0].getEncBits(series[0].size() - 1);
+			std::cout << "\t" << series[0].getMemUsage().live;
 		}
-		avgT /= CLOCKS_PER_SEC; // Average time in seconds.
-		avgT *= 1E6; // Average time in micro-seconds.
-		std::cout << "\t" << avgT;
-
-		// Decompression time.
-		avgT = 0;
-		t = clock();
-		for (int i = 0; i < l; i++) {
-			for (int j = 0; j < B3; j++) {
-				bsVec[i].getZlibDistEnc(v);
-			}
+
+		// =============================================================
+		// Speed of store of sequences
+		// =============================================================
+		
+		if (g) {
+			std::cout << "\t" << measureAll(l, B11, [&]() {
+				store.clear();
+				for (int i = 0; i < l; i++) store.add(bsVec[i]);
+			});
+			std::cout << "\t" << measureAll(l, B12, [&]() {
+				for (int i = 0; i < l; i++) store.getDist(i, v);
+			});
+			std::cout << "\t" << store.getMemUsage().live / l;
 		}
-		avgT += clock() - t;
+
+		// =============================================================
+		// Memory and heap allocations
+		// =============================================================
 		
-		avgT /= l*B3; // Average time in clocks.
-		if (CLOCKS_PER_SEC < l*B3*avgT) { // Adjust test time to about 1s.
-			B3 = CLOCKS_PER_SEC / (l*avgT) + 1;
+		if (m) {
+			int64_t live = 0, unused = 0, peak = 0;
+			for (int i = 0; i < l; i++) {
+				MemUsage mem = bsVec[i].getMemUsage();
+				live += mem.live;
+				unused += mem.unused;
+				peak += mem.peak;
+			}
+			std::cout << "\t" << live / l << "\t" << unused / l << "\t" << peak / l;
+			
+			// Operations as timed above (output vector is reused).
+			std::cout << "\t" << countAllocs(bsVec, [](BitString &bs) {
+				bs.clearEnc();
+				bs.setAcsbsDistEnc();
+			});
+			std::cout << "\t" << countAllocs(bsVec, [&v](BitString &bs) {
+				bs.getAcsbsDistEnc(v);
+			});
+			std::cout << "\t" << countAllocs(bsVec, [](BitString &bs) {
+				bs.clearEnc();
+				bs.setRiceDistEnc();
+			});
+			std::cout << "\t" << countAllocs(bsVec, [&v](BitString &bs) {
+				bs.getRiceDistEnc(v);
+			});
 		}
-		avgT /= CLOCKS_PER_SEC; // Average time in seconds.
-		avgT *= 1E6; // Average time in micro-seconds.
-		std::cout << "\t" << avgT;
 
 		std::cout << std::endl << std::flush;
 		
 		// =============================================================
 		// Find new vectors.
 		// =============================================================
-		for (int i = 0; i < l; i++) {
+		for (int i = 0; c.empty() && i < l; i++) {
 			// Increase number of ones by s.
-			bsVec[i].random(s, true);
-			bsVec[i].findDist();
+			if (inc) {
+				bsVec[i].randomInsert(s);
+			} else if (w) {
+				workload.generate(n, k + s, v);
+				bsVec[i].clear();
+				bsVec[i].flipDist(v);
+				bsVec[i].findDist();
+			} else if (r) {
+				bsVec[i].randomRuns(s, r, true);
+				bsVec[i].findDist();
+			} else {
+				bsVec[i].random(s, true);
+				bsVec[i].findDist();
+			}
 		}
 	}
 	
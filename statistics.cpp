@@ -1,4 +1,7 @@
 #include "compstat.h"
+#include "corpus.h"
+#include "memstat.h"
+#include "workload.h"
 
 #include <iostream>
 #include <string>
@@ -7,7 +10,19 @@ const char *help =
 	"-n\tNumber of bits in sequence.\n"
 	"-min\tMinimum number of ones in sequence (minimum k).\n"
 	"-max\tMaximum number of ones in sequence (maximum k).\n"
-	"-s\tStep to the next k.\n";
+	"-s\tStep to the next k.\n"
+	"-z\tTurn off ZLIB.\n"
+	"-i\tGrow the same sequences by s ones per step (not with -w). Ones and AC-SBS and\n"
+	"\tRice-Golomb sizes are updated in O(log n) per one, but ZLIB and -e still take\n"
+	"\tO(n) per sequence and step.\n"
+	"-w\tGenerate sequences by workload (uniform, markov:run, powerlaw:exponent,\n"
+	"\tperiodic:jitter, burst:size:gap).\n"
+	"-ws\tSeed of workload generator.\n"
+	"-c\tStatistics of sequences of corpus file or directory (*.bits, *.pos), row per sequence.\n"
+	"-cb\tBits of sequences in raw corpus files (0 = whole file).\n"
+	"-e\tEstimate code word bits from sample of given size (compared with optimal).\n"
+	"-p\tSpread of compressed sizes (standard deviation, 99th percentile, maximum).\n"
+	"-m\tMemory held by sequence (live, unused, peak bytes) and heap allocations per sequence.\n";
 
 int
 main(int argc, char *argv[])
@@ -22,6 +37,20 @@ main(int argc, char *argv[])
 	int s = 1;
 	// Default option to test ZLIB.
 	int z = 1;
+	// Default option to grow sequences incrementally.
+	int inc = 0;
+	// Default workload generator (none = ones at random).
+	Workload workload;
+	int w = 0;
+	// Default corpus (none = generated sequences).
+	std::string c;
+	int cBits = 0;
+	// Default sample size of code word bits estimation (0 = off).
+	int e = 0;
+	// Default option to print memory statistics.
+	int m = 0;
+	// Default option to print spread of compressed sizes.
+	int p = 0;
 	
 	while (*(++argv)) {
 		// Number of bits in sequence.
@@ -39,24 +68,109 @@ main(int argc, char *argv[])
 		// Turn off ZLIB.
 		} else if (*argv == std::string("-z")) {
 			z = 0;
+		// Grow sequences incrementally.
+		} else if (*argv == std::string("-i")) {
+			inc = 1;
+		// Workload generator.
+		} else if (*argv == std::string("-w")) {
+			if (!workload.parse(*(++argv))) {
+				printf("%s", help);
+				return 0;
+			}
+			w = 1;
+		// Seed of workload generator.
+		} else if (*argv == std::string("-ws")) {
+			workload.seed(std::stoull(*(++argv)));
+		// Corpus of sequences.
+		} else if (*argv == std::string("-c")) {
+			c = *(++argv);
+		// Bits of sequences in raw corpus files.
+		} else if (*argv == std::string("-cb")) {
+			cBits = std::stoi(*(++argv));
+		// Estimate code word bits from sample.
+		} else if (*argv == std::string("-e")) {
+			e = std::stoi(*(++argv));
+		// Spread of compressed sizes.
+		} else if (*argv == std::string("-p")) {
+			p = 1;
+		// Memory statistics.
+		} else if (*argv == std::string("-m")) {
+			m = 1;
 		} else {
 			printf("%s", help);
 			return 0;
 		}
 	}
 	
+	// Workload sequences are generated from scratch.
+	if (inc && w) {
+		printf("%s", help);
+		return 0;
+	}
+	
+	if (!c.empty()) {
+		Corpus corpus;
+		if (!corpus.load(c, cBits)) return 1;
+		std::vector<int> dist;
+		
+		std::cout << "corpus=" << c << std::endl;
+		BinSeqStat::printStatHeader(0 < e, m, p);
+		for (int i = 0; i < corpus.size(); i++) {
+			int64_t allocs = getAllocStat().allocs;
+			corpus.getDist(i, dist);
+			BinSeqStat bs(dist);
+			bs.findCompStat(z == 0);
+			if (0 < e) bs.findEstimateStat(e);
+			if (m) bs.findMemStat(getAllocStat().allocs - allocs);
+			bs.printStat(p);
+		}
+		return 0;
+	}
+	
 	std::cout << "n=" << n << std::endl;
-	BinSeqStat::printStatHeader();
+	if (w) std::cout << "workload=" << workload.name() << std::endl;
+	BinSeqStat::printStatHeader(0 < e, m, p);
+	
+	if (inc) {
+		// The same sequences get s more ones per step, statistics of step are merged.
+		std::vector<BinSeqStat> seqs;
+		seqs.reserve(100);
+		for (int i = 0; i < 100; i++) {
+			seqs.emplace_back(n, kMin);
+		}
+		for (int k = kMin; k < kMax; k += s) {
+			for (int i = 0; i < 100; i++) {
+				int64_t allocs = getAllocStat().allocs;
+				seqs[i].clearStat();
+				if (k != kMin) seqs[i].randomInsert(s);
+				seqs[i].findCompStat(z == 0);
+				if (0 < e) seqs[i].findEstimateStat(e);
+				if (m) seqs[i].findMemStat(getAllocStat().allocs - allocs);
+			}
+			for (int i = 1; i < 100; i++) {
+				seqs[0].merge(seqs[i]);
+			}
+			seqs[0].printStat(p);
+		}
+		return 0;
+	}
 	
 	for (int k = kMin; k < kMax; k += s) {
 		BinSeqStat bs(n, k);
 	
 		for (int i = 0; i < 100; i++) {
-			bs.random();
+			int64_t allocs = getAllocStat().allocs;
+			if (w) {
+				bs.random(workload);
+			} else {
+				bs.random();
+			}
 			bs.findCompStat(z == 0);
+			if (0 < e) bs.findEstimateStat(e);
+			if (m) bs.findMemStat(getAllocStat().allocs - allocs);
 		}
 	
-		bs.printStat();
+		bs.printStat(p);
 	}
 	
 	return 0;
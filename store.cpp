@@ -0,0 +1,265 @@
+#include "store.h"
+#include "kernels.h"
+
+#include <algorithm>
+
+//! Bits of arena offset in directory entry (tag is in the top byte).
+#define STORE_OFFSET_BITS 56
+//! Distances decoded at once by queries (on stack).
+#define STORE_PART 256
+
+//! Bit offset of code words of directory entry.
+static inline uint64_t
+entryOffset(const StoreEntry &e)
+{
+	return e.offset & (((uint64_t)1 << STORE_OFFSET_BITS) - 1);
+}
+
+//! Tag of directory entry (codec in low 3 bits, code word bits in high 5 bits).
+static inline int
+entryTag(const StoreEntry &e)
+{
+	return e.offset >> STORE_OFFSET_BITS;
+}
+
+BitmapStore::BitmapStore(Codec codec):
+	mCodec(codec)
+{
+	clear();
+}
+
+void
+BitmapStore::clear()
+{
+	// Arena starts with padding words only, the last entry marks its end.
+	mArena.assign(DECODE_PAD_WORDS, 0);
+	mEntries.assign(1, StoreEntry{ 0, 0, 0 });
+}
+
+void
+BitmapStore::reserve(int count, int64_t encBits)
+{
+	mEntries.reserve(count + 1);
+	mArena.reserve((encBits + 63) / 64 + DECODE_PAD_WORDS);
+}
+
+void
+BitmapStore::shrink()
+{
+	mEntries.shrink_to_fit();
+	mArena.shrink_to_fit();
+}
+
+int
+BitmapStore::add(const int *dist, int count)
+{
+	// Optimal code word bits of both codecs.
+	int acsbsCost[WORD_BITS_MAX];
+	int riceCost[WORD_BITS_MAX];
+	kernels().acsbsCost(dist, count, acsbsCost);
+	kernels().riceCost(dist, count, riceCost);
+	int acsbsBits = 1;
+	for (int w = 2; w < WORD_BITS_MAX; w++) {
+		if (acsbsCost[w] < acsbsCost[acsbsBits]) acsbsBits = w;
+	}
+	int riceBits = 0;
+	for (int w = 1; w < WORD_BITS_MAX; w++) {
+		if (riceCost[w] < riceCost[riceBits]) riceBits = w;
+	}
+
+	Codec codec = mCodec;
+	if (codec != CODEC_ACSBS && codec != CODEC_RICE) {
+		codec = (acsbsCost[acsbsBits] <= riceCost[riceBits]) ? CODEC_ACSBS : CODEC_RICE;
+	}
+	bool acsbs = codec == CODEC_ACSBS;
+	int w = acsbs ? acsbsBits : riceBits;
+
+	// Code words follow the previous bitmap in zeroed arena.
+	uint64_t begin = entryOffset(mEntries.back());
+	uint64_t end = begin + (acsbs ? acsbsCost[w] : riceCost[w]);
+	mArena.resize((end + 63) / 64 + DECODE_PAD_WORDS, 0);
+	Word64 *enc = mArena.data() + begin / 64;
+	if (acsbs) {
+		kernels().acsbsEncode(dist, count, w, enc, begin % 64);
+	} else {
+		kernels().riceEncode(dist, count, w, enc, begin % 64);
+	}
+
+	int64_t bits = count - 1;
+	for (int i = 0; i < count; i++) bits += dist[i];
+
+	StoreEntry &e = mEntries.back();
+	e.offset = begin | (uint64_t)(codec | w << 3) << STORE_OFFSET_BITS;
+	e.bits = bits;
+	e.ones = count - 1;
+	mEntries.push_back(StoreEntry{ end, 0, 0 });
+	return mEntries.size() - 2;
+}
+
+int
+BitmapStore::add(const std::vector<int> &dist)
+{
+	return add(dist.data(), dist.size());
+}
+
+int
+BitmapStore::add(const BitString &bs)
+{
+	std::vector<int> dist(bs.getOnes() + 1);
+	bs.getDist(0, dist.size(), dist.data());
+	return add(dist);
+}
+
+int
+BitmapStore::size() const
+{
+	return mEntries.size() - 1;
+}
+
+int
+BitmapStore::getBits(int id) const
+{
+	return mEntries[id].bits;
+}
+
+int
+BitmapStore::getOnes(int id) const
+{
+	return mEntries[id].ones;
+}
+
+Codec
+BitmapStore::getCodec(int id) const
+{
+	return (Codec)(entryTag(mEntries[id]) & 0x7);
+}
+
+int
+BitmapStore::getWordBits(int id) const
+{
+	return entryTag(mEntries[id]) >> 3;
+}
+
+int
+BitmapStore::getEncBits(int id) const
+{
+	return entryOffset(mEntries[id + 1]) - entryOffset(mEntries[id]);
+}
+
+int64_t
+BitmapStore::getEncBits() const
+{
+	return entryOffset(mEntries.back());
+}
+
+MemUsage
+BitmapStore::getMemUsage() const
+{
+	MemUsage mem;
+	mem.live = sizeof(*this);
+	mem.live += sizeof(Word64)*mArena.capacity() + sizeof(StoreEntry)*mEntries.capacity();
+	mem.unused = sizeof(Word64)*(mArena.capacity() - mArena.size());
+	mem.unused += sizeof(StoreEntry)*(mEntries.capacity() - mEntries.size());
+	// Buffers only grow until clear().
+	mem.peak = mem.live;
+	return mem;
+}
+
+bool
+BitmapStore::getDist(int id, std::vector<int> &dist) const
+{
+	dist.resize(getOnes(id) + 1);
+	if (getDist(id, dist.data())) return true;
+	dist.clear();
+	return false;
+}
+
+bool
+BitmapStore::getDist(int id, int *dist) const
+{
+	const StoreEntry &e = mEntries[id];
+	uint64_t offset = entryOffset(e);
+	const Word64 *enc = mArena.data() + offset / 64;
+	int begin = offset % 64;
+	int end = begin + getEncBits(id);
+	int count = e.ones + 1;
+	int n = (getCodec(id) == CODEC_ACSBS) ?
+		kernels().acsbsDecode(enc, &begin, end, getWordBits(id), dist, count) :
+		kernels().riceDecode(enc, &begin, end, getWordBits(id), dist, count);
+	if (n != count || begin != end) return false;
+
+	// Distances have to fill bitmap.
+	int64_t bits = e.ones;
+	for (int i = 0; i < count; i++) bits += dist[i];
+	return bits == e.bits;
+}
+
+bool
+BitmapStore::get(int id, BitString &bs) const
+{
+	std::vector<int> dist;
+	if (!getDist(id, dist)) return false;
+	bs.setDist(dist);
+	return true;
+}
+
+template <typename Op>
+bool
+BitmapStore::forDist(int id, Op op) const
+{
+	const StoreEntry &e = mEntries[id];
+	uint64_t offset = entryOffset(e);
+	const Word64 *enc = mArena.data() + offset / 64;
+	int begin = offset % 64;
+	int end = begin + getEncBits(id);
+	bool acsbs = getCodec(id) == CODEC_ACSBS;
+	int w = getWordBits(id);
+
+	int dist[STORE_PART];
+	for (int rest = e.ones + 1; 0 < rest; ) {
+		int count = std::min(rest, STORE_PART);
+		int n = acsbs ?
+			kernels().acsbsDecode(enc, &begin, end, w, dist, count) :
+			kernels().riceDecode(enc, &begin, end, w, dist, count);
+		if (n <= 0) return false;
+		rest -= n;
+		if (!op(dist, n)) return true;
+	}
+	return begin == end;
+}
+
+int
+BitmapStore::rank(int id, int bit) const
+{
+	int ones = 0;
+	int64_t pos = -1;
+	bool valid = forDist(id, [&](const int *dist, int n) {
+		for (int i = 0; i < n; i++) {
+			pos += dist[i] + 1;
+			if (bit <= pos) return false;
+			ones++;
+		}
+		return true;
+	});
+	if (!valid) return -1;
+	// The 'virtual' one is not counted.
+	return std::min(ones, getOnes(id));
+}
+
+int
+BitmapStore::select(int id, int i) const
+{
+	if (i < 0 || getOnes(id) <= i) return -1;
+
+	int j = 0;
+	int64_t pos = -1;
+	bool valid = forDist(id, [&](const int *dist, int n) {
+		for (int k = 0; k < n; k++) {
+			pos += dist[k] + 1;
+			if (j++ == i) return false;
+		}
+		return true;
+	});
+	if (!valid) return -1;
+	return (i < j) ? pos : -1;
+}
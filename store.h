@@ -0,0 +1,94 @@
+#ifndef __STORE_H__
+#define __STORE_H__
+
+#include "compress.h"
+
+#include <vector>
+
+//! Directory entry of bitmap in store.
+struct StoreEntry
+{
+	//! Bit offset of code words in arena (low 56 bits) and tag (codec in low 3 bits and
+	//! code word bits in high 5 bits of the top byte), code words end at the next entry.
+	uint64_t offset;
+	//! Bits of bitmap.
+	uint32_t bits;
+	//! Number of ones of bitmap.
+	uint32_t ones;
+};
+
+//! Collection of many bitmaps encoded by AC-SBS or Rice-Golomb into one contiguous arena
+//! with 16-byte directory entry per bitmap (instead of BitString with own buffers).
+//! Store is built by add() and then read by any number of threads at once (const
+//! methods do not change anything, adding must not run concurrently with reading).
+class BitmapStore
+{
+public:
+	//! Store encoding bitmaps by given codec (AC-SBS, Rice-Golomb or the smaller of them
+	//! for CODEC_AUTO).
+	BitmapStore(Codec codec = CODEC_AUTO);
+
+	//! Remove all bitmaps.
+	void clear();
+	//! Reserve room for given number of bitmaps and bits of code words.
+	void reserve(int count, int64_t encBits);
+	//! Release capacity beyond content (after the last add()).
+	void shrink();
+	//! Add bitmap given by distances (including the 'virtual' one) with optimal code word
+	//! bits, returns its ID.
+	int add(const int *dist, int count);
+	//! Add bitmap given by distances (including the 'virtual' one), returns its ID.
+	int add(const std::vector<int> &dist);
+	//! Add bitmap of string, returns its ID.
+	int add(const BitString &bs);
+
+	//! Number of bitmaps.
+	int size() const;
+	//! Bits of bitmap with given ID.
+	int getBits(int id) const;
+	//! Number of ones of bitmap with given ID.
+	int getOnes(int id) const;
+	//! Codec of bitmap with given ID (AC-SBS or Rice-Golomb).
+	Codec getCodec(int id) const;
+	//! Code word bits of bitmap with given ID.
+	int getWordBits(int id) const;
+	//! Bits of code words of bitmap with given ID.
+	int getEncBits(int id) const;
+	//! Bits of code words of all bitmaps.
+	int64_t getEncBits() const;
+	//! Memory held by store (arena and directory).
+	MemUsage getMemUsage() const;
+
+	//! Decode distances (including the 'virtual' one) of bitmap with given ID, false if
+	//! its code words are malformed.
+	bool getDist(int id, std::vector<int> &dist) const;
+	//! Decode distances of bitmap with given ID into room for getOnes(id) + 1 distances,
+	//! false if its code words are malformed.
+	bool getDist(int id, int *dist) const;
+	//! Decode bitmap with given ID into string (kept as distances), false if its code
+	//! words are malformed.
+	bool get(int id, BitString &bs) const;
+	//! Number of ones before given bit of bitmap with given ID (decodes up to the bit),
+	//! -1 if its code words are malformed.
+	int rank(int id, int bit) const;
+	//! Position of the i-th one of bitmap with given ID counted from 0, -1 if there is
+	//! not or code words are malformed (decodes up to the one).
+	int select(int id, int i) const;
+
+protected:
+	//! Decode distances of bitmap with given ID by parts, op gets distances and their
+	//! number and returns false to stop (the 'virtual' distance is passed as well),
+	//! returns false if code words are malformed.
+	template <typename Op>
+	bool forDist(int id, Op op) const;
+
+private:
+	//! Codec of new bitmaps.
+	Codec mCodec;
+	//! Code words of all bitmaps (with padding of decoders).
+	std::vector<Word64> mArena;
+	//! Directory of bitmaps with entry marking the end of arena.
+	std::vector<StoreEntry> mEntries;
+};
+
+#endif // __STORE_H__
@@ -0,0 +1,119 @@
+#include "pipeline.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+const char *help =
+	"Compress packed bitmap (least significant bit of byte first) from standard input\n"
+	"into frames on standard output.\n"
+	"-c\tCodec (acsbs, rice).\n"
+	"-b\tChunk size [KiB] read at once (the next one is read during encoding).\n"
+	"-d\tDecompress frames back to packed bitmap.\n"
+	"-v\tPrint sizes and throughput to standard error.\n";
+
+int
+main(int argc, char *argv[])
+{
+	// Default codec.
+	Codec codec = CODEC_ACSBS;
+	// Default chunk size [KiB].
+	int b = 1024;
+	// Default option to decompress.
+	int d = 0;
+	// Default option to print statistics.
+	int v = 0;
+	
+	while (*(++argv)) {
+		// Codec.
+		if (*argv == std::string("-c") && argv[1]) {
+			std::string name = *(++argv);
+			if (name == "acsbs") {
+				codec = CODEC_ACSBS;
+			} else if (name == "rice") {
+				codec = CODEC_RICE;
+			} else {
+				fprintf(stderr, "%s", help);
+				return 1;
+			}
+		// Chunk size.
+		} else if (*argv == std::string("-b") && argv[1]) {
+			b = std::stoi(*(++argv));
+			if (b < 1 || 65536 < b) {
+				fprintf(stderr, "%s", help);
+				return 1;
+			}
+		// Decompress.
+		} else if (*argv == std::string("-d")) {
+			d = 1;
+		// Print statistics.
+		} else if (*argv == std::string("-v")) {
+			v = 1;
+		} else {
+			fprintf(stderr, "%s", help);
+			return 1;
+		}
+	}
+	
+	auto t = std::chrono::steady_clock::now();
+	int64_t in = 0;
+	int64_t out = 0;
+	
+	if (d) {
+		StreamDecoder decoder;
+		const Word64 *words;
+		int bits;
+		int r;
+		while (0 < (r = decoder.decode(stdin, words, bits))) {
+			fwrite(words, 1, (bits + 7) / 8, stdout);
+			out += bits;
+		}
+		if (r < 0) {
+			std::cerr << "Malformed or truncated stream." << std::endl;
+			return 1;
+		}
+	} else {
+		// Frames are written while the next chunk is read.
+		ChunkReader reader(stdin, 1024*b);
+		StreamEncoder encoder(codec);
+		const Word64 *data;
+		int size;
+		while (0 < (size = reader.next(data))) {
+			in += 8*size;
+			if (!encoder.encode(data, 8*size)) {
+				std::cerr << "Too long run of zeros." << std::endl;
+				return 1;
+			}
+			fwrite(encoder.frame(), 1, encoder.frameBytes(), stdout);
+			out += 8*encoder.frameBytes();
+		}
+		if (size < 0) {
+			std::cerr << "Cannot read input." << std::endl;
+			return 1;
+		}
+		if (!encoder.finish()) {
+			std::cerr << "Too long run of zeros." << std::endl;
+			return 1;
+		}
+		fwrite(encoder.frame(), 1, encoder.frameBytes(), stdout);
+		out += 8*encoder.frameBytes();
+	}
+	fflush(stdout);
+	if (ferror(stdout)) {
+		std::cerr << "Cannot write output." << std::endl;
+		return 1;
+	}
+	
+	if (v) {
+		double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+		int64_t bitmap = d ? out : in;
+		// Frames are not counted by decoder.
+		if (!d) std::cerr << "in=" << in << " bits, ";
+		std::cerr << "out=" << out << " bits";
+		if (!d && in) std::cerr << ", ratio=" << (double)out / in;
+		std::cerr << ", " << bitmap / 8 / s / 1E6 << " MB/s" << std::endl;
+	}
+	
+	return 0;
+}
@@ -0,0 +1,161 @@
+#include "workload.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+//! Names of distributions (indexed by kind).
+static const char *workloadNames[WORKLOAD_COUNT] = {
+	"uniform", "markov", "powerlaw", "periodic", "burst"
+};
+
+//! Default first and second parameters (indexed by kind).
+static const double workloadDefaults[WORKLOAD_COUNT][2] = {
+	{ 0, 0 }, { 16, 0 }, { 1.5, 0 }, { 0.1, 0 }, { 64, 2 }
+};
+
+Workload::Workload(WorkloadKind kind, double param, double param2, uint64_t seed):
+	mKind(kind),
+	mParam(param ? param : workloadDefaults[kind][0]),
+	mParam2(param2 ? param2 : workloadDefaults[kind][1]),
+	mRandom(seed),
+	mLeft(0),
+	mShift(0)
+{
+}
+
+bool
+Workload::parse(const std::string &spec)
+{
+	std::string name = spec.substr(0, spec.find(':'));
+	for (int kind = 0; kind < WORKLOAD_COUNT; kind++) {
+		if (name != workloadNames[kind]) continue;
+		
+		double param[2] = { 0, 0 };
+		size_t pos = spec.find(':');
+		for (int i = 0; i < 2 && pos != std::string::npos; i++) {
+			param[i] = std::atof(spec.c_str() + pos + 1);
+			pos = spec.find(':', pos + 1);
+		}
+		mKind = (WorkloadKind)kind;
+		mParam = param[0] ? param[0] : workloadDefaults[kind][0];
+		mParam2 = param[1] ? param[1] : workloadDefaults[kind][1];
+		return true;
+	}
+	return false;
+}
+
+void
+Workload::seed(uint64_t seed)
+{
+	mRandom.seed(seed);
+	mLeft = 0;
+	mShift = 0;
+}
+
+void
+Workload::generate(int n, int k, std::vector<int> &dist)
+{
+	if (n < k) k = n;
+	dist.resize(k + 1);
+	
+	// Scalable parts of gaps have the shape of distribution and fill zeros which are
+	// left by fixed parts (fixed parts are scaled too if they do not fit).
+	std::vector<double> raw(k + 1);
+	std::vector<double> fixed(k + 1);
+	double sum = 0;
+	double fixedSum = 0;
+	mLeft = 0;
+	mShift = 0;
+	for (int i = 0; i < k + 1; i++) {
+		raw[i] = gap(fixed[i]);
+		sum += raw[i];
+		fixedSum += fixed[i];
+	}
+	double fixedScale = 1;
+	if (n - k < fixedSum) {
+		fixedScale = (n - k) / fixedSum;
+		fixedSum = n - k;
+	}
+	double scale = (0 < sum) ? (n - k - fixedSum) / sum : 0;
+	
+	// Rounding error is carried to the next gap, the 'virtual' one gets the rest.
+	int zeros = n - k;
+	double carry = 0;
+	for (int i = 0; i < k; i++) {
+		double d = raw[i]*scale + fixed[i]*fixedScale + carry;
+		int z = std::max(0, std::min((int)std::floor(d + 0.5), zeros));
+		carry = d - z;
+		dist[i] = z;
+		zeros -= z;
+	}
+	dist[k] = zeros;
+}
+
+WorkloadKind
+Workload::kind() const
+{
+	return mKind;
+}
+
+const char *
+Workload::name() const
+{
+	return workloadNames[mKind];
+}
+
+const char *
+Workload::names()
+{
+	return "uniform, markov:run, powerlaw:exponent, periodic:jitter, burst:size:gap";
+}
+
+double
+Workload::uniform()
+{
+	// 53 random bits give the same numbers on every platform.
+	return (mRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double
+Workload::geometric(double mean)
+{
+	if (mean <= 0) return 0;
+	return std::floor(std::log(1 - uniform()) / std::log(mean / (mean + 1)));
+}
+
+double
+Workload::gap(double &fixed)
+{
+	fixed = 0;
+	switch (mKind) {
+	case WORKLOAD_MARKOV:
+		// Ones stay in run with probability 1 - 1/run (zero gap), otherwise the chain
+		// moves to zeros and the next run starts after geometric gap.
+		if (0 < mLeft--) return 0;
+		mLeft = geometric(mParam - 1);
+		return 1 + geometric(1000);
+	case WORKLOAD_POWER_LAW:
+		// Lomax (shifted Pareto) gaps, P(gap > x) ~ x^-exponent (finite mean for exponent > 1).
+		return std::pow(1 - uniform(), -1 / std::max(mParam, 1.01)) - 1;
+	case WORKLOAD_PERIODIC:
+	{
+		// Period is 1 before scaling, every one is shifted from its period by up to half
+		// of jitter either way (shifts do not accumulate over gaps).
+		double shift = mParam*(uniform() - 0.5);
+		double step = 1 + shift - mShift;
+		mShift = shift;
+		return std::max(0.0, step);
+	}
+	case WORKLOAD_BURST:
+		// Short gaps of given mean inside burst, long gap between bursts.
+		if (0 < mLeft--) {
+			fixed = geometric(mParam2);
+			return 0;
+		}
+		mLeft = geometric(mParam - 1);
+		return 1 + geometric(1000);
+	default:
+		return geometric(1000);
+	}
+}
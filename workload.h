@@ -0,0 +1,71 @@
+#ifndef __WORKLOAD_H__
+#define __WORKLOAD_H__
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+//! Distributions of ones in generated sequences.
+enum WorkloadKind
+{
+	//! Ones placed uniformly (geometric gaps).
+	WORKLOAD_UNIFORM = 0,
+	//! Runs of ones from two-state Markov chain (param: mean run length).
+	WORKLOAD_MARKOV = 1,
+	//! Power-law (Lomax) gaps (param: tail exponent > 1).
+	WORKLOAD_POWER_LAW = 2,
+	//! Periodic ones with jitter (param: jitter as fraction of period).
+	WORKLOAD_PERIODIC = 3,
+	//! Bursts of dense ones (params: mean ones per burst, mean gap inside burst).
+	WORKLOAD_BURST = 4,
+	WORKLOAD_COUNT = 5
+};
+
+//! Seedable generator of sparse sequences with non-uniform distributions in O(k).
+class Workload
+{
+public:
+	//! Generator of given distribution (zero params select defaults).
+	Workload(WorkloadKind kind = WORKLOAD_UNIFORM, double param = 0, double param2 = 0,
+		uint64_t seed = 1);
+	//! Generator given by specification "name[:param[:param2]]" (false if not known).
+	bool parse(const std::string &spec);
+
+	//! Restart pseudo-random sequence.
+	void seed(uint64_t seed);
+	//! Distances between k ones (and the 'virtual' one) of sequence of n bits.
+	void generate(int n, int k, std::vector<int> &dist);
+
+	//! Distribution of generated sequences.
+	WorkloadKind kind() const;
+	//! Name of distribution.
+	const char *name() const;
+	//! Names of distributions (for help).
+	static const char *names();
+
+protected:
+	//! Uniform number from [0, 1).
+	double uniform();
+	//! Geometric number of failures with given mean.
+	double geometric(double mean);
+	//! Raw gap before next one to be scaled to sequence length (fixed receives part
+	//! of gap which is not scaled).
+	double gap(double &fixed);
+
+private:
+	//! Distribution.
+	WorkloadKind mKind;
+	//! The first parameter.
+	double mParam;
+	//! The second parameter.
+	double mParam2;
+	//! Pseudo-random generator.
+	std::mt19937_64 mRandom;
+	//! Ones left in current run or burst.
+	int mLeft;
+	//! Shift of the last one from its period (periodic workload).
+	double mShift;
+};
+
+#endif // __WORKLOAD_H__